@@ -0,0 +1,103 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#ifndef _EMAILCIRCUITBREAKER_H_
+#define _EMAILCIRCUITBREAKER_H_
+
+#include <SimpleTools/SimpleTools.h>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * Delivery health of an SMTP server, shared by all email senders configured with the same server URL.
+ *
+ * After threshold consecutive failed deliveries the circuit opens: no deliveries are attempted for delay milliseconds, so
+ * an unreachable server doesn't cost a full SMTP timeout per email. Then a single probe delivery is let through (half-open);
+ * its success closes the circuit, its failure opens it again. A probe which never reports back is replaced by another one
+ * after the same delay. While half-open, only the current probe's result counts; deliveries which were started earlier, and
+ * replaced probes, report their results too late to say anything about the server now.
+ *
+ * It is only used by the email delivery, which logs within a PluginDeliveryScope, so its logs are not sent by email.
+ */
+class EmailCircuitBreaker
+{
+   public:
+    enum State
+    {
+        Closed,
+        Open,
+        HalfOpen
+    };
+
+    EmailCircuitBreaker() noexcept;
+
+    // prevent copying and assignment
+    DELETE_COPY_AND_ASSIGNMENT(EmailCircuitBreaker);
+
+    // Returns the circuit breaker of the given server, creating it on first use.
+    static std::shared_ptr<EmailCircuitBreaker> GetForServer(const std::string& serverUrl);
+
+    // A threshold of 0 disables the circuit breaker; the failures are still counted.
+    void Configure(int threshold, int delay) noexcept;
+
+    // Returns true if a delivery may be attempted now. In half-open state, only the first caller gets the probe; probe is set to its
+    // (non-zero) number then, 0 otherwise, and must be passed to ReportResult().
+    bool TryAcquire(uint64_t& probe) noexcept;
+
+    // Returns true if a delivery would be refused right now, without taking the probe. If so, retryTime is set to the time
+    // (SteadyTime) when it makes sense to ask again.
+    bool IsBlocked(uint64_t& retryTime) noexcept;
+
+    // Reports the outcome of a delivery, allowed by TryAcquire().
+    void ReportResult(bool success, uint64_t probe) noexcept;
+
+    State GetState() noexcept;
+
+    // Returns a short description, for example "circuit open, 5 consecutive failures, 12 failures in total".
+    std::string GetStatusText();
+
+    static const char* GetStateName(State state) noexcept;
+
+   private:
+    int m_threshold;
+    int m_delay;  // in milliseconds
+    State m_state;
+    uint64_t m_stateTime;  // SteadyTime of the last transition to Open, or of the last probe in HalfOpen
+    bool m_probing;        // a probe delivery is in progress
+    uint64_t m_probe;      // number of the last probe
+    uint64_t m_consecutiveFailures;
+    uint64_t m_failures;
+    uint64_t m_deliveries;
+    uint64_t m_openings;
+    std::mutex m_cs;  // protects all of the above
+
+    void Refresh(uint64_t now) noexcept;
+};
+
+#endif
@@ -0,0 +1,160 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#ifndef _EMAILDELIVERYPOOL_H_
+#define _EMAILDELIVERYPOOL_H_
+
+#include <Email/EmailSender.h>
+#include <Email/EmailSpool.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <thread>
+
+/**
+ * Bounded email delivery pool, shared by the logger email plugins.
+ *
+ * A single delivery thread drives all SMTP transfers concurrently, through the curl multi interface, so any number of
+ * plugins (and SMTP servers) is served without a thread per transfer. Emails of the same owner (typically a plugin) are
+ * delivered one at a time, in the order of submission. Each queued email carries everything needed for the delivery
+ * (including a shared pointer to its EmailSender), so the owner may be destroyed while its emails are still queued.
+ *
+ * The queue is bounded: when it's full, a new email is merged into the last queued email of the same owner (bodies are
+ * concatenated, attachments collected), or the oldest queued email is dropped if there is none. This keeps the number of
+ * emails (and SMTP connections) under control during alert storms.
+ *
+ * Emails for an SMTP server whose circuit breaker is open (see EmailCircuitBreaker) are not attempted; they stay queued
+ * (or spooled) until the server is probed again.
+ *
+ * With an optional spool, emails are not lost when the SMTP server is unreachable: failed emails, emails pushed out of the
+ * full queue and emails still queued (or being delivered) at shutdown are written to the spool, and retried with backoff.
+ * Spooled emails which are due go before the queued emails of the same owner, since they are older; while a failed email
+ * waits for its next attempt, the newer emails of its owner are not held back. To be able to retry the emails spooled by a
+ * previous run, owners have to register with a name which stays the same across restarts. The spool files are written
+ * without holding the pool lock.
+ *
+ * On destruction, the pool waits up to timeoutOnShutdown for the queued emails, once for all owners; the owners themselves only
+ * submit their last emails.
+ */
+class EmailDeliveryPool
+{
+   public:
+    EmailDeliveryPool(size_t maxConcurrentDeliveries, size_t maxPendingEmails, std::unique_ptr<EmailSpool> spool = nullptr,
+                      int timeoutOnShutdown = 0);
+    ~EmailDeliveryPool();
+
+    // prevent copying and assignment
+    DELETE_COPY_AND_ASSIGNMENT(EmailDeliveryPool);
+
+    // Registers the owner's name (for the spool) and the sender to be used for its spooled emails.
+    void RegisterOwner(const void* owner, const std::string& name, std::shared_ptr<EmailSender> sender);
+
+    // Logs a warning about the spooled emails of owners which are not registered (for example of a plugin removed from the
+    // configuration); they are never delivered, they only expire. To be called once all owners are registered.
+    void ReportOrphans();
+
+    // Queues an email; never blocks. The owner is only used to keep the emails of the same owner in order.
+    void Submit(const void* owner, std::shared_ptr<EmailSender> sender, const std::string& subject,
+                const std::vector<std::string>& recipients, std::shared_ptr<const IEmailBody> body, int timeout = 0,
+                std::vector<EmailAttachment> attachments = {});
+
+    // Waits until all queued emails are delivered or the timeout (in milliseconds) expires; returns true if the queue is empty.
+    bool Drain(int timeout);
+
+    // Waits for the queued emails (up to the timeout), then aborts the deliveries still in progress and joins the delivery
+    // thread, which takes no longer than the abort itself. Emails which are not delivered by then are spooled, if possible.
+    // The destructor calls it with timeoutOnShutdown, so the pool must be destroyed before the logger.
+    void Shutdown(int timeout);
+
+    size_t GetPendingCount();
+
+   private:
+    struct Email
+    {
+        const void* owner;
+        std::string ownerName;  // empty if the owner isn't registered; such emails can't be spooled
+        std::shared_ptr<EmailSender> sender;
+        std::string subject;
+        std::vector<std::string> recipients;
+        std::vector<std::shared_ptr<const IEmailBody>> bodyParts;  // more than one if emails were merged
+        int timeout;
+        std::vector<EmailAttachment> attachments;
+        uint64_t spoolSequence;  // 0 unless the email comes from the spool
+    };
+
+    struct Owner
+    {
+        const void* owner;
+        std::string name;
+        std::shared_ptr<EmailSender> sender;
+    };
+
+    // an email being delivered, only used by the delivery thread
+    struct Delivery
+    {
+        Email email;
+        std::unique_ptr<EmailTransfer> transfer;
+        uint64_t probe = 0;  // see EmailCircuitBreaker::TryAcquire()
+    };
+
+    size_t m_maxConcurrentDeliveries;
+    size_t m_maxPendingEmails;
+    std::unique_ptr<EmailSpool> m_spool;  // optional
+    int m_timeoutOnShutdown;              // in milliseconds, see Shutdown()
+    void* m_multi;                        // CURLM handle, used by the delivery thread (and to wake it up)
+    std::thread m_thread;
+
+    std::mutex m_cs;  // protects everything below
+    std::condition_variable m_cv;
+    std::deque<Email> m_queue;
+    std::vector<const void*> m_busyOwners;  // owners with an email being delivered (or spooled) right now, once per email
+    std::vector<Owner> m_owners;            // registered owners
+    size_t m_activeDeliveries;
+    bool m_stopping;
+    uint64_t m_delivered;
+    uint64_t m_failed;
+    uint64_t m_merged;
+    uint64_t m_dropped;
+    uint64_t m_spooled;
+    uint64_t m_retried;  // spooled emails, delivered later
+
+    void Thread();
+    bool TakeEmail(Email& email);
+    void StartDelivery(std::vector<Delivery>& deliveries, Email email);
+    void CompleteDelivery(Delivery& delivery, bool success);
+    void PostponeDelivery(Delivery& delivery);
+    uint64_t GetCircuitRetryTime() const;
+    bool IsOwnerAvailable(const std::string& name) const;
+    bool TakeSpooledEmail(Email& email);
+    bool SpoolEmail(const Email& email, int attempts);
+    void SpoolOrDrop(const Email& email, const char* reason);
+    void ReleaseOwner(const void* owner);
+    void WakeUp();
+};
+
+#endif
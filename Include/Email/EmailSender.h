@@ -2,6 +2,71 @@
 #define _EMAILSENDER_H_
 
 #include <JsonConfig/JsonConfig.h>
+#include <Email/EmailCircuitBreaker.h>
+#include <string_view>
+#include <memory>
+
+/**
+ * Email body, made of pieces which are rendered on demand, while the email is being sent.
+ *
+ * This way a large body (for example a batch of logs) never has to exist as one big string; only the piece being sent is
+ * rendered. The body must not change once it's handed over for delivery, and it may be read several times (when the
+ * delivery is retried) and from different threads.
+ */
+class IEmailBody
+{
+   public:
+    virtual ~IEmailBody() = default;
+
+    virtual size_t GetPieceCount() const = 0;
+
+    // Returns the piece with the given index; it may point into the body itself, or into the scratch string, which the
+    // implementation may use for rendering.
+    virtual std::string_view GetPiece(size_t index, std::string& scratch) const = 0;
+};
+
+// Body consisting of a single string.
+class StringEmailBody : public IEmailBody
+{
+   public:
+    explicit StringEmailBody(std::string text) : m_text(std::move(text)) {}
+
+    size_t GetPieceCount() const override { return 1; }
+    std::string_view GetPiece(size_t, std::string&) const override { return m_text; }
+
+   private:
+    std::string m_text;
+};
+
+struct EmailAttachment
+{
+    std::string fileName;
+    std::string contentType;  // for example "application/gzip"
+    std::string data;
+};
+
+/**
+ * Email delivery in progress, driven by a curl multi handle; see EmailSender::StartTransfer().
+ */
+class EmailTransfer
+{
+   public:
+    ~EmailTransfer();
+
+    // prevent copying and assignment
+    DELETE_COPY_AND_ASSIGNMENT(EmailTransfer);
+
+    // Returns the curl easy handle, to be added to the multi handle.
+    void* GetHandle() const noexcept;
+
+   private:
+    friend class EmailSender;
+    struct Data;
+
+    explicit EmailTransfer(std::unique_ptr<Data> data) noexcept;
+
+    std::unique_ptr<Data> m_data;
+};
 
 class EmailSender
 {
@@ -15,20 +80,71 @@ class EmailSender
     static EmailSender* GetInstance() noexcept;
     static void SetInstance(EmailSender* instance) noexcept;
 
+    // Reads the settings; the timeouts and the circuit breaker settings are also applied whenever the section changes.
     void Configure(JsonConfig& cfg, const std::string& section);
 
+    // Sends the email and waits until it's delivered. The connections are kept for the next email, as with StartTransfer, but
+    // only one email is sent over them at a time; if they're busy, a temporary connection is used instead. Attachments are
+    // base64-encoded. Returns a CURLcode; when the circuit breaker of the server is open, the email is not sent and
+    // CURLE_COULDNT_CONNECT is returned right away.
     int SendSimpleEmail(const std::string& subject, const std::string& utf8body, const std::vector<std::string>& toAddresses,
-                        const std::string& sourceAddress = "", int timeout = 0);
+                        const std::string& sourceAddress = "", int timeout = 0, const std::vector<EmailAttachment>& attachments = {});
+
+    // Same as SendSimpleEmail, but the body is made of the given parts, which are streamed to the server piece by piece.
+    int SendEmail(const std::string& subject, const std::vector<const IEmailBody*>& bodyParts, const std::vector<std::string>& toAddresses,
+                  const std::string& sourceAddress = "", int timeout = 0, const std::vector<EmailAttachment>& attachments = {});
+
+    // Prepares the email for delivery through a curl multi handle, so a single thread can drive many deliveries at once.
+    // The connections are kept in the connection cache of the multi handle (idleTimeout applies there). The body parts and
+    // attachments must stay valid until the transfer is finished. Returns nullptr on failure. Unlike SendEmail, it leaves the
+    // circuit breaker to the caller, which is expected to acquire it first and report the result.
+    std::unique_ptr<EmailTransfer> StartTransfer(const std::string& subject, const std::vector<const IEmailBody*>& bodyParts,
+                                                 const std::vector<std::string>& toAddresses, const std::string& sourceAddress = "",
+                                                 int timeout = 0, const std::vector<EmailAttachment>& attachments = {}) const;
+
+    // Finishes the transfer, once the multi handle reports it done with the given CURLcode, and returns the CURLcode. If a
+    // reused connection failed before any of the email was uploaded (most likely because the server closed it), the transfer
+    // is prepared for another attempt over a new connection and retry is set; the handle must be added to the multi handle
+    // again in that case.
+    int FinishTransfer(EmailTransfer& transfer, int result, bool& retry) const;
+
+    // Closes the connections kept by SendEmail (if any); new ones are opened by the next email.
+    void CloseConnection() noexcept;
+
+    // Returns the circuit breaker of the configured SMTP server, shared with all senders of the same server.
+    EmailCircuitBreaker& GetCircuitBreaker() const noexcept { return *m_circuitBreaker; }
 
    private:
     static EmailSender* m_instance;
 
     std::string m_smtpServerUrl;
     int m_sslFlag;  // see CURLOPT_USE_SSL option in libcurl
+    bool m_sslVerifyPeer;
     std::string m_username;
     std::string m_password;
     std::string m_defaultSourceAddress;
-    int m_timeout;  // in milliseconds
+    std::atomic<int> m_timeout;      // in milliseconds
+    std::atomic<int> m_idleTimeout;  // in milliseconds, 0 means that the connection is closed after each email
+
+    void* m_multi;    // curl multi handle, which keeps the connections of SendEmail for the next email
+    std::mutex m_cs;  // protects m_multi
+
+    std::shared_ptr<EmailCircuitBreaker> m_circuitBreaker;
+
+    JsonConfig* m_cfg;  // the configuration we're subscribed to
+    std::string m_section;
+    size_t m_subscription;
+
+    // Reads the settings, which can change while emails are being sent (see OnConfigurationChanged).
+    void ConfigureLive(JsonConfig& cfg, const std::string& section);
+    void OnConfigurationChanged(const json* oldValue, const json* newValue);
+
+    void* CreateCurlHandle() const;
+    void SetupTransfer(EmailTransfer& transfer, const std::string& subject, const std::vector<const IEmailBody*>& bodyParts,
+                       const std::vector<std::string>& toAddresses, const std::string& fromAddress, int timeout,
+                       const std::vector<EmailAttachment>& attachments) const;
+    void LogResult(int result, const std::string& toString, uint64_t startTime, long newConnections) const;
+    int Perform(EmailTransfer& transfer);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,127 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#ifndef _EMAILSPOOL_H_
+#define _EMAILSPOOL_H_
+
+#include <Email/EmailSender.h>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+
+/**
+ * Disk-backed spool for undelivered emails.
+ *
+ * Each email is written once, to its own file in the spool directory (compact binary format with a CRC-32 checksum), and
+ * removed after a successful delivery. Files are named by an increasing sequence number, so the emails keep their order,
+ * also across restarts. The spool only keeps a small index in memory; the email content is read from disk when it's time
+ * for the next delivery attempt.
+ *
+ * Failed attempts are retried with exponential backoff and jitter, starting with retryDelay and doubling up to
+ * maxRetryDelay. When the total size of the spool would exceed maxSize, the oldest emails are discarded. Emails older than
+ * maxAge (if not 0) are discarded as well, which eventually cleans up the emails of owners that no longer exist.
+ */
+class EmailSpool
+{
+   public:
+    // Creates the directory if necessary and indexes the emails left over from previous runs; they are due immediately. Their
+    // age is taken from the file modification time.
+    EmailSpool(const std::filesystem::path& directory, uint64_t maxSize, int retryDelay, int maxRetryDelay, uint64_t maxAge = 0);
+
+    // prevent copying and assignment
+    DELETE_COPY_AND_ASSIGNMENT(EmailSpool);
+
+    // Writes an email to the spool. The owner identifies the sender, which will retry the delivery. Emails which have already
+    // failed (attempts > 0) are due after the backoff delay, others immediately. Returns false if the email could not be stored.
+    bool Store(const std::string& owner, const std::string& subject, const std::vector<std::string>& recipients,
+               const std::vector<std::shared_ptr<const IEmailBody>>& bodyParts, const std::vector<EmailAttachment>& attachments,
+               int attempts);
+
+    // Takes the oldest due email of an available owner and marks it as busy; returns its sequence number, or 0 if there is none.
+    uint64_t TakeDue(const std::function<bool(const std::string&)>& isOwnerAvailable, std::string& owner);
+
+    // Returns the time (SteadyTime) of the next attempt for any available owner, or UINT64_MAX if there is nothing to retry.
+    uint64_t GetNextAttemptTime(const std::function<bool(const std::string&)>& isOwnerAvailable);
+
+    // Reads a busy email from disk and verifies the checksum. Damaged emails are removed and false is returned.
+    bool Load(uint64_t sequence, std::string& subject, std::vector<std::string>& recipients, std::string& body,
+              std::vector<EmailAttachment>& attachments);
+
+    // Removes a busy email after a successful delivery.
+    void Remove(uint64_t sequence);
+
+    // Releases a busy email after a failed delivery and schedules the next attempt.
+    void Reschedule(uint64_t sequence);
+
+    // Releases a busy email which was not attempted after all; it stays due, the number of attempts doesn't change.
+    void Release(uint64_t sequence);
+
+    // Discards the emails older than maxAge (except the busy ones); returns their number. Cheap if there is nothing to discard.
+    size_t Expire();
+
+    // Returns the number of spooled emails of each owner.
+    std::map<std::string, size_t> GetOwners();
+
+    size_t GetCount();
+    uint64_t GetSize();
+    uint64_t GetMaxAge() const noexcept { return m_maxAge; }
+
+   private:
+    struct Entry
+    {
+        std::string owner;
+        uint64_t size;
+        int attempts;
+        uint64_t nextAttemptTime;  // SteadyTime
+        uint64_t expiryTime;       // SteadyTime, UINT64_MAX if the email never expires
+        bool busy;
+    };
+
+    std::filesystem::path m_directory;
+    uint64_t m_maxSize;
+    int m_retryDelay;     // in milliseconds
+    int m_maxRetryDelay;  // in milliseconds
+    uint64_t m_maxAge;    // in milliseconds, 0 means that the emails never expire
+
+    std::map<uint64_t, Entry> m_entries;  // sequence -> entry, the oldest first
+    uint64_t m_size;                      // total size of the spooled files, including the ones being written
+    uint64_t m_nextSequence;
+    uint64_t m_nextExpiryTime;  // the earliest expiryTime of all entries (or later)
+    std::mt19937 m_random;  // for the jitter
+    std::mutex m_cs;        // protects all of the above
+
+    std::filesystem::path GetFilePath(uint64_t sequence) const;
+    uint64_t GetNextAttemptTime(int attempts);
+    uint64_t GetExpiryTime(uint64_t age) const;
+    void RemoveEntry(std::map<uint64_t, Entry>::iterator it);
+};
+
+#endif
@@ -0,0 +1,195 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#ifndef _CONFIGSCHEMA_H_
+#define _CONFIGSCHEMA_H_
+
+#include <JsonConfig/JsonConfig.h>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <type_traits>
+
+/**
+ * Declarative binding of a configuration section to a settings struct, with validation.
+ *
+ * The schema lists the keys of the section, together with the struct members they are stored in, their default values and, for
+ * numbers, the allowed range. Bind() parses the whole section at once, so the hot paths can read plain struct members instead of
+ * walking the JSON tree on every access:
+ *
+ *   static const auto schema = ConfigSchema<WatchDogSettings>()
+ *                                  .Field("args", &WatchDogSettings::args)
+ *                                  .Field("restartDelay", &WatchDogSettings::restartDelay, 5000, 0, INT_MAX);
+ *   const WatchDogSettings settings = schema.Bind(Cfg, "svcWatchDog");
+ *
+ * Unlike the JsonConfig getters, Bind() is strict: values of a wrong type, values out of range and unknown keys (typically typos)
+ * are all collected and reported together, each with its full path, in a single std::runtime_error. Keys containing a space, such
+ * as "DISABLED email" or "OPTIONAL subject", are considered commented out and ignored. A missing key gets its default value and a
+ * missing section is the same as an empty one. Numbers are converted the same way as with JsonConfig::GetNumber().
+ */
+template <typename T>
+class ConfigSchema
+{
+   public:
+    // Adds a key of any type nlohmann::json can convert to; numbers may have any value of their type.
+    template <typename F>
+    ConfigSchema& Field(const std::string& key, F T::*member, std::type_identity_t<F> defaultValue = F())
+    {
+        if constexpr (std::is_arithmetic_v<F> && !std::is_same_v<F, bool>)
+        {
+            return Field(key, member, defaultValue, std::numeric_limits<F>::lowest(), std::numeric_limits<F>::max());
+        }
+        else
+        {
+            const auto bind = [=](const json* value, T& target, const std::string& path, std::vector<std::string>& errors)
+            {
+                target.*member = defaultValue;
+                if (value)
+                {
+                    try
+                    {
+                        target.*member = value->template get<F>();
+                    }
+                    catch (const std::exception& e)
+                    {
+                        errors.push_back(path + ": invalid value " + value->dump() + " (" + e.what() + ")");
+                    }
+                }
+            };
+            m_fields.push_back({key, bind});
+            return *this;
+        }
+    }
+
+    // Adds a numeric key with the allowed range (inclusive); with a unit, strings may carry a unit suffix (see ConfigUnit).
+    template <typename F>
+        requires(std::is_arithmetic_v<F> && !std::is_same_v<F, bool>)
+    ConfigSchema& Field(const std::string& key, F T::*member, std::type_identity_t<F> defaultValue, std::type_identity_t<F> minValue,
+                        std::type_identity_t<F> maxValue, ConfigUnit unit = ConfigUnit::None)
+    {
+        const auto bind = [=](const json* value, T& target, const std::string& path, std::vector<std::string>& errors)
+        {
+            target.*member = defaultValue;
+            if (!value)
+            {
+                return;
+            }
+
+            // booleans and fractions would otherwise be quietly converted, and the range is checked before the conversion to F, so
+            // large values can't wrap around
+            F number{};
+            if (value->is_boolean() || (std::is_integral_v<F> && value->is_number_float()) ||
+                !JsonConfig::TryParseNumber(*value, number, unit))
+            {
+                errors.push_back(path + ": " + value->dump() + " is not a valid " + (std::is_integral_v<F> ? "integer" : "number"));
+            }
+            else if (value->is_number() ? (value->template get<double>() < static_cast<double>(minValue) ||
+                                           value->template get<double>() > static_cast<double>(maxValue))
+                                        : (number < minValue || number > maxValue))
+            {
+                errors.push_back(path + ": " + value->dump() + " is out of range [" + std::to_string(minValue) + ", " +
+                                 std::to_string(maxValue) + "]");
+            }
+            else
+            {
+                target.*member = number;
+            }
+        };
+        m_fields.push_back({key, bind});
+        return *this;
+    }
+
+    // Accepts a key, which is read elsewhere (for example before the section can be bound), so it isn't reported as unknown.
+    ConfigSchema& ExternalField(const std::string& key)
+    {
+        m_fields.push_back({key, [](const json*, T&, const std::string&, std::vector<std::string>&) {}});
+        return *this;
+    }
+
+    // Parses the section of the given snapshot; throws std::runtime_error, listing all the problems, if the section is not valid.
+    T Bind(const json& root, const std::string& section) const { return BindSection(JsonConfig::FindSection(root, section), section); }
+
+    // Parses the section data (nullptr if the section doesn't exist), for example the one passed to a JsonConfig::SectionCallback;
+    // the section name is only used in the error messages.
+    T BindSection(const json* sectionData, const std::string& section) const
+    {
+        std::vector<std::string> errors;
+        if (sectionData && !sectionData->is_object())
+        {
+            errors.push_back(section + ": expected an object, not " + sectionData->type_name());
+            sectionData = nullptr;
+        }
+
+        T result{};
+        for (const auto& field : m_fields)
+        {
+            const json* value = nullptr;
+            if (sectionData)
+            {
+                const auto it = sectionData->find(field.key);
+                value = it != sectionData->end() ? &*it : nullptr;
+            }
+            field.bind(value, result, section + "." + field.key, errors);
+        }
+
+        if (sectionData)
+        {
+            for (const auto& item : sectionData->items())
+            {
+                if (item.key().find(' ') == std::string::npos &&
+                    std::none_of(m_fields.begin(), m_fields.end(), [&item](const FieldBinding& field) { return field.key == item.key(); }))
+                {
+                    errors.push_back(section + "." + item.key() + ": unknown key");
+                }
+            }
+        }
+
+        if (!errors.empty())
+        {
+            throw std::runtime_error("invalid configuration section '" + section + "': " + JoinStrings(errors, "; "));
+        }
+        return result;
+    }
+
+    // Parses the section of the current configuration snapshot.
+    T Bind(JsonConfig& cfg, const std::string& section) const { return Bind(*cfg.GetSnapshot(), section); }
+
+    // Returns the settings with all the default values.
+    T GetDefaults() const { return Bind(json::object(), ""); }
+
+   private:
+    struct FieldBinding
+    {
+        std::string key;
+        std::function<void(const json* value, T& target, const std::string& path, std::vector<std::string>& errors)> bind;
+    };
+
+    std::vector<FieldBinding> m_fields;
+};
+
+#endif
@@ -32,9 +32,178 @@
 #include <SimpleTools/SimpleTools.h>
 // #undef snprintf
 #include <nlohmann/json.hpp>
+#include <string_view>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <map>
+#include <iterator>
 
 using json = nlohmann::json;
 
+/**
+ * Unit of a numeric configuration value. Numbers given as strings may then carry a unit suffix, for example "10MB", "500ms" or "5s",
+ * and are converted to the base unit (the one the application expects). Plain numbers are always in the base unit.
+ */
+enum class ConfigUnit
+{
+    None,          // no suffixes allowed
+    Bytes,         // B, KB, MB, GB, TB (powers of 1024)
+    Milliseconds,  // ms, s, min, h, d
+    Seconds        // ms (whole seconds only), s, min, h, d
+};
+
+/**
+ * Pre-parsed configuration path, for example "log.email.someRecipients.maxDelay".
+ *
+ * The path is split into its tokens only once, so lookups through a ConfigPath neither parse the path nor allocate
+ * anything. Keep the handles of frequently read values (for example as static or member variables) and pass them to
+ * the JsonConfig getters instead of the section and key strings. An empty path refers to the root of the configuration.
+ */
+class ConfigPath
+{
+   public:
+    explicit ConfigPath(std::string_view path);
+    ConfigPath(const ConfigPath& section, std::string_view key);
+
+    const std::vector<std::string>& GetTokens() const noexcept { return m_tokens; }
+    std::string ToString() const;
+
+   private:
+    std::vector<std::string> m_tokens;
+};
+
+/**
+ * Lazy range over the keys of a configuration object (ConfigKeyProjection) or the strings of a configuration array
+ * (ConfigStringProjection). The items are read from the snapshot as they are iterated over, as string_views, so nothing is copied
+ * or allocated. The range keeps the snapshot alive, so the string_views stay valid as long as the range exists.
+ */
+template <typename Projection>
+class ConfigRange
+{
+   public:
+    class Iterator
+    {
+       public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = std::string_view;
+
+        Iterator() = default;
+        Iterator(json::const_iterator current, json::const_iterator end, unsigned filter) : m_current(current), m_end(end), m_filter(filter)
+        {
+            Skip();
+        }
+
+        std::string_view operator*() const { return Projection::Get(m_current); }
+        Iterator& operator++()
+        {
+            ++m_current;
+            Skip();
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            Iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+        bool operator==(const Iterator& other) const { return m_current == other.m_current; }
+
+       private:
+        json::const_iterator m_current;
+        json::const_iterator m_end;
+        unsigned m_filter = 0;
+
+        void Skip()
+        {
+            while (m_current != m_end && !Projection::Accept(*m_current, m_filter))
+            {
+                ++m_current;
+            }
+        }
+    };
+
+    ConfigRange(std::shared_ptr<const json> snapshot, const json* container, unsigned filter = 0)
+        : m_snapshot(std::move(snapshot)),
+          m_container(container && Projection::IsContainer(*container) ? container : &Projection::Empty()),
+          m_filter(filter)
+    {
+    }
+
+    Iterator begin() const { return Iterator(m_container->cbegin(), m_container->cend(), m_filter); }
+    Iterator end() const { return Iterator(m_container->cend(), m_container->cend(), m_filter); }
+    bool empty() const { return begin() == end(); }
+
+   private:
+    std::shared_ptr<const json> m_snapshot;
+    const json* m_container;
+    unsigned m_filter;
+};
+
+// The keys of the object members, whose types are included in the filter.
+struct ConfigKeyProjection
+{
+    static constexpr unsigned Objects = 1;
+    static constexpr unsigned Arrays = 2;
+    static constexpr unsigned Others = 4;
+
+    static bool IsContainer(const json& container) { return container.is_object(); }
+    static const json& Empty();
+    static bool Accept(const json& value, unsigned filter)
+    {
+        return (filter & (value.is_object() ? Objects : value.is_array() ? Arrays : Others)) != 0;
+    }
+    static std::string_view Get(const json::const_iterator& item) { return item.key(); }
+};
+
+// The string elements of an array; the other elements are skipped.
+struct ConfigStringProjection
+{
+    static bool IsContainer(const json& container) { return container.is_array(); }
+    static const json& Empty();
+    static bool Accept(const json& value, unsigned) { return value.is_string(); }
+    static std::string_view Get(const json::const_iterator& item) { return item->get_ref<const std::string&>(); }
+};
+
+using ConfigKeyRange = ConfigRange<ConfigKeyProjection>;
+using ConfigStringRange = ConfigRange<ConfigStringProjection>;
+
+/**
+ * Read-only view of a configuration value (usually a section) in a snapshot, returned by JsonConfig::GetView(). The view keeps the
+ * snapshot alive, so the returned string_views and ranges stay valid as long as the view (or the range) exists, even if the
+ * configuration is reloaded in the meantime. Nothing is copied or allocated. The keys are looked up in the viewed object only (use
+ * GetView() to go deeper), and like with JsonConfig, missing or invalid values give the default ones.
+ */
+class ConfigView
+{
+   public:
+    ConfigView() = default;
+    ConfigView(std::shared_ptr<const json> snapshot, const json* value) noexcept : m_snapshot(std::move(snapshot)), m_value(value) {}
+
+    bool Exists() const noexcept { return m_value != nullptr; }
+    const json* GetJson() const noexcept { return m_value; }
+
+    ConfigView GetView(std::string_view key) const;
+    std::string_view GetString(std::string_view key, std::string_view defaultValue = "") const;
+    template <typename T>
+    T GetNumber(std::string_view key, T defaultValue, ConfigUnit unit = ConfigUnit::None) const;
+    bool GetBool(std::string_view key, bool defaultValue = false) const;
+
+    // The same filters as JsonConfig::GetKeys(), and the strings of an array (the counterpart of JsonConfig::GetStringVector()).
+    ConfigKeyRange GetKeys(bool includeObjects, bool includeArrays, bool includeOthers) const;
+    ConfigStringRange GetStrings(std::string_view key) const;
+
+   private:
+    std::shared_ptr<const json> m_snapshot;
+    const json* m_value = nullptr;
+
+    const json* Find(std::string_view key) const;
+};
+
 /**
  * @brief JsonConfig is a lightweight wrapper around the nlohmann::json library, designed
  *        to simplify the use of JSON files as configuration sources.
@@ -46,6 +215,14 @@ using json = nlohmann::json;
  * its getter functions never throw exceptions. Instead, they quietly return the provided default value if a key is missing or any parsing
  * error occurs. This makes it ideal for relaxed, fault-tolerant configuration scenarios. If your application demands stricter validation
  * and error reporting, JsonConfig may not be the right tool.
+ *
+ * The configuration is kept in an immutable snapshot, which is replaced as a whole when the file is reloaded (see Reload() and
+ * StartWatching()), so the getters never lock and never see a half-updated configuration. Each getter reads from a single snapshot;
+ * use GetSnapshot() to read several values from the same one.
+ *
+ * The configuration may consist of several layers, which are merged into the snapshot once per load, so the lookups don't pay for
+ * them: the files listed in "$include" (for example a base shared by all the instances and a per-host file), the file itself and
+ * the environment variables (see SetEnvironmentPrefix()). GetSource() tells which layer has set a value.
  */
 class JsonConfig
 {
@@ -58,23 +235,110 @@ class JsonConfig
     static JsonConfig* GetInstance() noexcept;
     static void SetInstance(JsonConfig* instance) noexcept;
 
-    void Load(const std::filesystem::path& filePath);
-    json* GetJson(const std::string& path = "");
+    // Loads the configuration file. If sections are given, only these top-level sections are parsed; the others are skipped over
+    // (only their brackets and strings are checked), which makes large generated files much cheaper to load. Syntax errors are
+    // reported with the line and the column.
+    // The top-level "$include" key may list other files (a path or an array of paths, relative to the including file), which are
+    // loaded first, in the given order, and overridden by the including file. ${NAME} in the paths is replaced with the environment
+    // variable NAME (${HOSTNAME} falls back to the computer name), and the paths prefixed with '?' may be missing. Objects are merged
+    // key by key, null removes a key and any other value replaces the included one.
+    void Load(const std::filesystem::path& filePath, std::vector<std::string> sections = {});
+
+    // Loads the file, given to Load(), again and publishes it as a new snapshot. If the file can't be read or parsed, the error is
+    // logged and the current snapshot is kept. Returns true if the configuration was replaced (false also if the file didn't change).
+    bool Reload();
+
+    // Replaces the whole configuration with the given data, for example in tests and tools which don't use a file.
+    void SetJson(json data);
+
+    // Environment variables, whose names start with the prefix (in any case), are merged over the configuration files as the last
+    // layer; "__" separates the levels, so MYSERVICE__log__minConsoleLevel=2 sets minConsoleLevel in the log section. The values are
+    // parsed as JSON if possible (numbers, true, false, arrays, objects and null, which removes the key), otherwise they are taken
+    // as strings. Call it before Load(); the empty prefix (the default) ignores the environment.
+    void SetEnvironmentPrefix(std::string prefix);
+
+    // When Load() is given sections, the parsed configuration files (the requested sections, merged, without the environment layer)
+    // are kept in a binary cache file, which is loaded instead of them while none of them has changed its size, modification time or
+    // contents, so a large file is only hashed, not parsed, to find a few small sections. The whole configuration isn't cached,
+    // because building the json tree from the binary data is no faster than parsing the text. Call it before Load(); the empty path
+    // (the default) disables the cache.
+    void SetCacheFile(std::filesystem::path cacheFile);
+
+    // Returns the layer, which has set the value (or the section containing it): the path of the file or "environment variable
+    // NAME". Returns an empty string if the value doesn't exist or has been set by SetJson().
+    std::string GetSource(const std::string& path, const std::string& key = "") const;
+
+    // Returns the current snapshot, which never changes; it stays valid even if the configuration is reloaded in the meantime.
+    std::shared_ptr<const json> GetSnapshot() const noexcept;
+
+    // Returns a number, which changes whenever a new snapshot is published, so cached data derived from the configuration can be
+    // refreshed cheaply.
+    uint64_t GetGeneration() const noexcept;
+
+    // Receives the previous and the new value of a subscribed section; either of them is nullptr if the section doesn't exist.
+    using SectionCallback = std::function<void(const json* oldValue, const json* newValue)>;
+
+    // Calls the callback whenever a new snapshot changes the given section (or any other value, for example "log.email.someRecipients").
+    // Each subscribed section is hashed once per snapshot, and the callback is only called if the hash changes, so saving the file
+    // doesn't reconfigure the components whose sections are still the same. With notifyNow, the callback is also called right away,
+    // with the current value (and no previous one). The callbacks are called on the thread which publishes the snapshot (usually the
+    // watch thread), in the order of subscription; they may use the getters, but they must not load the configuration, subscribe or
+    // unsubscribe. Returns the id of the subscription.
+    size_t Subscribe(const std::string& section, SectionCallback callback, bool notifyNow = false);
+    void Unsubscribe(size_t id);
+
+    // Returns the keys of the section, which have been added, removed or changed, except for the ignored ones and the commented out
+    // ones (containing a space); handy for the subscribers, which can only apply some of the changes.
+    static std::vector<std::string> GetChangedKeys(const json* oldValue, const json* newValue,
+                                                   const std::vector<std::string>& ignoredKeys = {});
+
+    // Starts a thread, which reloads the configuration whenever the file, given to Load(), or any of the included files changes.
+    void StartWatching();
+    void StopWatching();
+
+    // Returns the value in the current snapshot, or null if it doesn't exist. The pointer shares the ownership of the snapshot, so
+    // the value stays valid even if the configuration is reloaded in the meantime.
+    std::shared_ptr<const json> GetJson(const std::string& path = "");
 
     std::string GetString(const std::string& path, const std::string& key, const std::string& defaultValue = "");
     int GetString(const std::string& path, const std::string& key, char* buffer, size_t bufferSize, const std::string& defaultValue = "");
 
     template <typename T>
-    T GetNumber(const std::string& path, const std::string& key, T defaultValue);
+    T GetNumber(const std::string& path, const std::string& key, T defaultValue, ConfigUnit unit = ConfigUnit::None);
     bool GetBool(const std::string& path, const std::string& key, bool defaultValue = false);
     std::vector<std::string> GetStringVector(const std::string& path, const std::string& key, std::vector<std::string> defaultValue = {});
     std::vector<std::string> GetKeys(const std::string& path, bool includeObjects, bool includeArrays, bool includeOthers);
 
+    // The same getters, taking the complete path of the value (section and key together) as a pre-parsed handle.
+    std::shared_ptr<const json> GetJson(const ConfigPath& path);
+    std::string GetString(const ConfigPath& path, const std::string& defaultValue = "");
+    int GetString(const ConfigPath& path, char* buffer, size_t bufferSize, const std::string& defaultValue = "");
+    template <typename T>
+    T GetNumber(const ConfigPath& path, T defaultValue, ConfigUnit unit = ConfigUnit::None);
+    bool GetBool(const ConfigPath& path, bool defaultValue = false);
+    std::vector<std::string> GetStringVector(const ConfigPath& path, std::vector<std::string> defaultValue = {});
+    std::vector<std::string> GetKeys(const ConfigPath& path, bool includeObjects, bool includeArrays, bool includeOthers);
+
+    // Returns a view of the section (or any other value) in the current snapshot, for reading the strings and enumerating the keys
+    // and the arrays without copying them (see ConfigView).
+    ConfigView GetView(const std::string& path = "");
+    ConfigView GetView(const ConfigPath& path);
+
+    // Converts a configuration value to a number the same way GetNumber() does. Numbers and strings are accepted; strings may be
+    // written in decimal, hex ("0x1F") or binary ("0b101"), with digit separators ("1_000_000" or "1'000'000") and, depending on
+    // the unit, with a unit suffix. Returns false if the value can't be converted or doesn't fit into T.
+    template <typename T>
+    static bool TryParseNumber(const json& parameter, T& value, ConfigUnit unit = ConfigUnit::None);
+
+    // Returns the section (or any other value) from the given snapshot, nullptr if it doesn't exist.
+    static const json* FindSection(const json& root, const std::string& section) { return FindKey(root, section, ""); }
+
     template <typename T>
     T ParseSection(const std::string& section)
     {
         // configure the plugin
-        json* sectionData = GetJson(section);
+        const auto snapshot = GetSnapshot();
+        const json* sectionData = FindSection(*snapshot, section);
         if (!sectionData)
         {
             throw std::runtime_error("configuration section '" + section + "' not found");
@@ -93,11 +357,74 @@ class JsonConfig
    private:
     static JsonConfig* m_instance;
 
-    json m_json;
+    using SourceMap = std::map<std::string, std::string>;  // path of a value -> layer, which has set it
 
-    json* FindKey(const std::string& path, const std::string& key);
+    struct FileState
+    {
+        std::filesystem::path path;
+        size_t hash;     // of the contents, 0 if the file is missing
+        uintmax_t size;  // size and last write time, as they were before the file has been read
+        int64_t time;
+    };
+    using FileList = std::vector<FileState>;
+
+    // all the layers of the configuration, merged together
+    struct Layers
+    {
+        json data = json::object();
+        SourceMap sources;
+        FileList files;
+        std::map<std::string, std::string> variables;  // the ones used in the include paths, with their values
+    };
+
+    // the published configuration together with the sources of its values, so both are always replaced at once
+    struct Snapshot
+    {
+        json data;
+        SourceMap sources;
+    };
+
+    std::atomic<std::shared_ptr<const Snapshot>> m_snapshot;
+    std::atomic<uint64_t> m_generation;
+    std::filesystem::path m_filePath;
+    std::vector<std::string> m_sections;  // top-level sections to load, empty means all
+    std::string m_environmentPrefix;
+    std::filesystem::path m_cacheFile;
+    FileList m_files;     // all the loaded files, so saving them without changes doesn't replace the snapshot
+    std::mutex m_loadCs;  // serializes loading, the getters don't need it
+    std::atomic_bool m_watching;
+    std::thread m_watchThread;
+
+    struct Subscription
+    {
+        size_t id;
+        ConfigPath path;
+        size_t hash;  // of the section in the current snapshot
+        SectionCallback callback;
+    };
+    std::vector<Subscription> m_subscriptions;  // protected by m_loadCs, like everything else involved in publishing
+    size_t m_lastSubscriptionId;
+
+    void WatchThread();
+    void WatchFiles(const std::vector<std::filesystem::path>& files);
+    std::vector<std::filesystem::path> GetFiles();
+    Layers LoadLayers(const std::filesystem::path& filePath, const std::vector<std::string>& sections, bool initial) const;
+    bool LoadCache(const std::filesystem::path& filePath, const std::vector<std::string>& sections, Layers& layers) const;
+    void SaveCache(const std::vector<std::string>& sections, const Layers& layers) const;
+    static void LoadFile(const std::filesystem::path& filePath, bool optional, bool map, const std::vector<std::string>& sections,
+                         Layers& layers, std::vector<std::filesystem::path>& includeStack);
+    void Publish(json data, SourceMap sources);
+    static size_t GetHash(const json* value);
+    static json Parse(std::string_view text, const std::vector<std::string>& sections);
+
+    static const json* FindKey(const json& root, const std::string& path, const std::string& key);
+    static const json* FindKey(const json& root, const ConfigPath& path);
+    template <typename T>
+    static T GetParameter(const json* parameter, T defaultValue);
     template <typename T>
-    T GetParameter(const std::string& path, const std::string& key, T defaultValue);
+    static T ParseNumber(const json* parameter, T defaultValue, ConfigUnit unit);
+    static int CopyString(const std::string& value, char* buffer, size_t bufferSize);
+    static std::vector<std::string> GetKeys(const json* section, bool includeObjects, bool includeArrays, bool includeOthers);
 };
 
 #define Cfg (*JsonConfig::GetInstance())
@@ -0,0 +1,90 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#ifndef _LOGDIGEST_H_
+#define _LOGDIGEST_H_
+
+#include <Logger/Logger.h>
+#include <array>
+#include <functional>
+#include <unordered_map>
+
+/**
+ * Incremental digest of log records, used to keep alert emails short.
+ *
+ * Records are grouped by call site, level and message template (the message with all numbers masked, which also masks
+ * any timestamps, ids and counters). Each group is emitted once, with the complete first log line, followed by the number
+ * of occurrences and the timestamps of the first and the last one. The records are aggregated as they arrive, so the
+ * memory use grows with the number of distinct lines only.
+ */
+class LogDigest
+{
+   public:
+    // Without aggregation, the digest simply keeps all lines.
+    explicit LogDigest(bool aggregate);
+
+    // prevent copying and assignment
+    DELETE_COPY_AND_ASSIGNMENT(LogDigest);
+
+    // Adds the record. New lines take their memory from the budget (if given); if the budget is exhausted, the record is
+    // dropped and false is returned. The memory taken is added to acquiredMemory (nothing is taken for merged records).
+    bool Add(const LogRecord& record, LogMemoryBudget* memoryBudget, size_t& acquiredMemory);
+
+    bool IsEmpty() const noexcept { return m_lines.empty(); }
+    size_t GetRecordCount() const noexcept { return m_recordCount; }  // all records, including the merged ones
+    size_t GetLineCount() const noexcept { return m_lines.size(); }
+    size_t GetRecordCount(LogLevel level) const noexcept { return m_levelCounts[level]; }
+    size_t GetTextLength() const noexcept { return m_textLength; }  // approximate length of the text
+
+    // The text, split into pieces: each line is followed by the number of occurrences (an empty piece if it's just one).
+    size_t GetPieceCount() const noexcept { return m_lines.size() * 2; }
+    std::string_view GetPiece(size_t index, std::string& scratch) const;
+
+    // Passes the text to the writer piece by piece, so it doesn't have to be assembled in memory (for example when compressing).
+    // Stops after maxLines lines (0 means all).
+    void WriteText(const std::function<void(std::string_view)>& writer, size_t maxLines = 0) const;
+
+   private:
+    struct Line
+    {
+        std::string formatted;      // first occurrence
+        std::string lastTimestamp;  // last occurrence
+        size_t count;
+    };
+
+    bool m_aggregate;
+    size_t m_recordCount;
+    std::array<size_t, MaskAllLogs> m_levelCounts;
+    size_t m_textLength;
+    std::vector<Line> m_lines;                        // in the order of the first occurrence
+    std::unordered_map<std::string, size_t> m_index;  // group key -> index in m_lines
+
+    static std::string GetKey(const LogRecord& record);
+};
+
+#endif
@@ -0,0 +1,76 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#ifndef _LOGFILETOOLS_H_
+#define _LOGFILETOOLS_H_
+
+#include <SimpleTools/SimpleTools.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <filesystem>
+
+/*
+ * Helpers for the log file tools (LogExtract, LogSearch) and the log file timestamp index.
+ *
+ * Next to each log file, the logger maintains a small text sidecar (for example SvcWatchDog.log.idx), which maps log
+ * timestamps to byte offsets every few KB of log data. Each line contains the timestamp of the first log line at the
+ * offset, a tab and the offset itself. The sidecar is renamed together with the log file on rotation, so tools can seek
+ * directly to the interesting part of any (current or rotated) log file.
+ */
+
+// length of the "YYYY-MM-DD HH:MM:SS.mmm" timestamp at the start of each log line
+#define LOG_TIMESTAMP_LENGTH 23
+
+struct LogIndexEntry
+{
+    std::string timestamp;  // "YYYY-MM-DD HH:MM:SS.mmm", so entries can be compared as strings
+    uint64_t offset;        // byte offset of the log line in the (uncompressed) log file
+};
+
+// Returns the path of the index for the given log file; compressed logs (.gz) share the index with the original file.
+std::filesystem::path GetLogIndexPath(const std::filesystem::path& logFilePath);
+
+// Returns the timestamp at the start of the log line, or an empty view if the line doesn't start with a timestamp (for
+// example a continuation line of a multi-line message).
+std::string_view GetLogTimestamp(std::string_view line) noexcept;
+
+// Returns true if the text is a valid prefix of a log timestamp, for example "2025-07-10 14:05"; such prefixes can be
+// compared with the log timestamps as strings.
+bool IsLogTimestampPrefix(std::string_view text);
+
+// Returns the current log file and all rotated ones next to it (including the gzip-compressed ones), in no particular order.
+std::vector<std::filesystem::path> FindLogFiles(const std::filesystem::path& logFilePath);
+
+// Appends entries to the index file; returns false on failure.
+bool AppendLogIndex(const std::filesystem::path& indexPath, const std::vector<LogIndexEntry>& entries);
+
+// Loads the index file, skipping malformed lines; returns an empty vector if the file doesn't exist or can't be read.
+std::vector<LogIndexEntry> LoadLogIndex(const std::filesystem::path& indexPath);
+
+#endif
@@ -30,11 +30,15 @@
 #define _LOGGER_H_
 
 #include <JsonConfig/JsonConfig.h>
+#include <Logger/LoggerStatistics.h>
 #include <vector>
 #include <queue>
 #include <sstream>
 #include <thread>
 #include <atomic>
+#include <span>
+#include <string_view>
+#include <chrono>
 
 enum LogLevel
 {
@@ -60,11 +64,94 @@ enum LogLevel
     MaskAllLogs
 };
 
+// Returns the three-letter level name, as used in the log lines (for example "INF").
+const char* GetLogLevelName(LogLevel level) noexcept;
+
+/**
+ * Memory budget shared by the logger file queue and all plugin queues.
+ *
+ * Every queued log line is accounted for with a cheap atomic counter, so the budget can be consulted from any thread
+ * without taking a lock. When the usage exceeds half of the limit, the logger flushes its queues early. When the limit
+ * itself is reached, lines below the Error level are dropped (and counted) until memory is released again.
+ */
+class LogMemoryBudget
+{
+   public:
+    LogMemoryBudget() noexcept;
+
+    // prevent copying and assignment
+    DELETE_COPY_AND_ASSIGNMENT(LogMemoryBudget);
+
+    // Sets the limit in bytes; 0 means unlimited (usage is still tracked).
+    void SetLimit(size_t limit) noexcept;
+    size_t GetLimit() const noexcept;
+
+    // Reserves memory for a queued item. Returns false and reserves nothing if the budget is exhausted, unless force is set.
+    bool Acquire(size_t bytes, bool force = false) noexcept;
+    void Release(size_t bytes) noexcept;
+
+    size_t GetCurrentUsage() const noexcept;
+    size_t GetPeakUsage() const noexcept;
+    uint64_t GetDroppedCount() const noexcept;
+
+    // Returns true when the usage is above half of the limit, which means it's time to flush early.
+    bool IsUnderPressure() const noexcept;
+
+    // Returns the number of bytes, accounted for a single queued log line.
+    static size_t GetLineCost(std::string_view line) noexcept { return line.length() + sizeof(std::string); }
+
+   private:
+    std::atomic<size_t> m_limit;
+    std::atomic<size_t> m_current;
+    std::atomic<size_t> m_peak;
+    std::atomic<uint64_t> m_dropped;
+};
+
+/**
+ * Structured log record, passed to the plugins in batches.
+ *
+ * All string views point into the logger's queue and are only valid for the duration of the ILoggerPlugin::LogBatch() call.
+ */
+struct LogRecord
+{
+    LogLevel level;
+    std::chrono::system_clock::time_point timestamp;
+    uint64_t callSiteId;          // identifies the source file and function within the running process, 0 if unknown
+    std::string_view module;      // location prefix, for example "EmailSender::SendSimpleEmail", empty if unknown
+    uint32_t threadId;            // thread id hash, truncated to 32 bits
+    std::string_view message;     // the message text only
+    std::string_view formatted;   // complete log line, including timestamp, level, location and the trailing newline
+    bool pluginDelivery;          // logged within a PluginDeliveryScope, by the code delivering the logs of a plugin
+};
+
+/**
+ * Marks the logs of the current thread, while the object exists, as logged by the code which delivers the logs of a plugin (for
+ * example, the email delivery). The plugin ignores such logs, otherwise each delivery could log something, which would have to be
+ * delivered again, and so on. The scopes may be nested.
+ */
+class PluginDeliveryScope
+{
+   public:
+    PluginDeliveryScope() noexcept : m_previous(m_active) { m_active = true; }
+    ~PluginDeliveryScope() { m_active = m_previous; }
+
+    // prevent copying and assignment
+    DELETE_COPY_AND_ASSIGNMENT(PluginDeliveryScope);
+
+    static bool IsActive() noexcept { return m_active; }
+
+   private:
+    static thread_local bool m_active;
+    bool m_previous;
+};
+
 /**
  * Logger plugin interface.
  *
  * Plugins must be registered before any logging threads start.
- * The Log() callback must be fast and non-blocking; use internal buffering/queueing if I/O is required.
+ * The logger collects the records and periodically passes them to LogBatch() from the logger thread (or from the thread
+ * calling Logger::Flush), never while holding the logger lock. Plugins should implement LogBatch() if they want to filter
+ * by record fields or avoid copying; simple plugins may implement Log() instead and rely on the default LogBatch().
  * Never call Logger methods from within plugin callbacks to avoid deadlock.
  */
 class ILoggerPlugin
@@ -72,14 +159,25 @@ class ILoggerPlugin
    public:
     virtual ~ILoggerPlugin() = default;
 
-    // Called from any thread; must be fast and non-blocking.
-    virtual void Log(LogLevel level, const std::string& message) = 0;
+    // Receives a batch of records of all levels. The default implementation passes the records at or above MinLogLevel()
+    // to Log(), one by one.
+    virtual void LogBatch(std::span<const LogRecord> records);
+
+    // Receives a single complete log line; only called by the default LogBatch() implementation.
+    virtual void Log(LogLevel level, const std::string& message);
 
     // Returns the minimum log level this plugin wants to receive.
     virtual LogLevel MinLogLevel() = 0;
 
     // Called periodically and during shutdown; may block briefly.
     virtual void Flush(bool stillRunning, bool force) = 0;
+
+    // Returns the plugin name, used in the logger statistics.
+    virtual std::string Name() { return "plugin"; }
+
+    // Returns a short description of the plugin health, included in the logger statistics; empty if there is nothing to
+    // report. May be called from any thread, at any time.
+    virtual std::string Status() { return ""; }
 };
 
 /**
@@ -105,12 +203,20 @@ class Logger
     static void SetInstance(Logger* instance) noexcept;
 
     void SetFileNamePostfix(const std::string& postfix) noexcept;
+    // Reads the settings; the levels, maxWriteDelay, maxQueueMemory and statisticsInterval are also applied whenever the section
+    // changes, the other settings need a restart.
     void Configure(JsonConfig& cfg, const std::string& section = "log");
 
     // Register plugins before Start() and before spawning additional threads.
     void RegisterPlugin(std::unique_ptr<ILoggerPlugin> plugin);
     LogLevel GetMinPluginLevel();
 
+    // The memory budget is shared by the file queue and the plugins, which may use it for their own queues.
+    LogMemoryBudget& GetMemoryBudget() noexcept;
+
+    // Returns a consistent-enough copy of all logger statistics; may be called from any thread, at any time.
+    LogStatisticsSnapshot GetStatistics() const;
+
     void Start();     // Starts the background logging thread.
     void Shutdown();  // Stops the logging thread and flushes all output.
     void Mute(bool mute) noexcept;
@@ -123,28 +229,63 @@ class Logger
    private:
     static Logger* m_instance;
 
-    LogLevel m_minConsoleLevel;
-    LogLevel m_minFileLevel;
+    std::atomic<LogLevel> m_minConsoleLevel;  // the levels and the limits may change on reload, see ConfigureLive()
+    std::atomic<LogLevel> m_minFileLevel;
     std::filesystem::path m_filePath;
     std::string
         m_fileNamePostfix;  // used when we run multiple instances of the same app on the same machine, for example several MPI processes
     int m_maxFileSize;
-    int m_maxWriteDelay;
+    std::atomic<int> m_maxWriteDelay;
     size_t m_maxOldFiles;
     bool m_logThreadId;
+    std::atomic<int> m_statisticsInterval;  // seconds, 0 means no periodic statistics summary
+    int m_indexInterval;       // KB of log data between timestamp index entries, 0 means no index
+    uint64_t m_lastIndexOffset;  // offset of the last index entry in the current log file, UINT64_MAX if there is none yet
+
+    // statistics sink indexes; plugins follow the file, in the order of registration
+    static constexpr size_t m_consoleSink = 0;
+    static constexpr size_t m_fileSink = 1;
+    LoggerStatistics m_statistics;
+
+    LogMemoryBudget m_memoryBudget;
+    uint64_t m_reportedDrops;
+
+    // A queued log line, together with the data needed to build a LogRecord. There is only one copy of each line, shared by the
+    // file output and all plugins.
+    struct QueuedRecord
+    {
+        LogLevel level;
+        std::chrono::system_clock::time_point timestamp;
+        uint64_t callSiteId;
+        uint32_t threadId;
+        uint32_t moduleOffset;
+        uint32_t moduleLength;
+        uint32_t messageOffset;
+        bool pluginDelivery;
+        std::string text;
+
+        size_t GetCost() const noexcept { return sizeof(QueuedRecord) + text.length(); }
+    };
+
+    JsonConfig* m_cfg;  // the configuration we're subscribed to
+    std::string m_section;
+    size_t m_subscription;
 
     std::vector<std::unique_ptr<ILoggerPlugin>> m_plugins;
     std::atomic_bool m_mute;
-    std::unique_ptr<std::queue<std::string>> m_fileQueue;
-    uint64_t m_emailTimestamp;
+    std::unique_ptr<std::vector<QueuedRecord>> m_queue;
     std::thread m_thread;
     SyncEvent m_threadTrigger;
     std::atomic_bool m_running;
 
-    std::mutex m_cs;
+    std::mutex m_cs;       // protects m_queue and console output
+    std::mutex m_flushCs;  // serializes flushing, so the file and the plugins receive the records in order
 
     void Thread();
-    void FlushFileQueue();
+    void ConfigureLive(JsonConfig& cfg, const std::string& section);
+    void OnConfigurationChanged(const json* oldValue, const json* newValue);
+    void FlushFileQueue(const std::vector<QueuedRecord>& records);
+    void DispatchToPlugins(const std::vector<QueuedRecord>& records);
     void LogErrorToConsole(const std::string& message);
 };
 
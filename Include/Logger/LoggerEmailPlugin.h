@@ -30,39 +30,59 @@
 #define _LOGGEREMAILPLUGIN_H_
 
 #include <Logger/Logger.h>
+#include <Logger/LogDigest.h>
 #include <Email/EmailSender.h>
+#include <Email/EmailDeliveryPool.h>
 
 class LoggerEmailPlugin : public ILoggerPlugin
 {
    public:
     static void ConfigureAll(JsonConfig& cfg, Logger& logger, const std::string& parentSection = "log.email");
 
-    LoggerEmailPlugin(JsonConfig& cfg, const std::string& section);
+    // If no delivery pool is given, the plugin creates its own, with a single thread.
+    LoggerEmailPlugin(JsonConfig& cfg, const std::string& section, std::shared_ptr<EmailDeliveryPool> deliveryPool = nullptr,
+                      LogMemoryBudget* memoryBudget = nullptr);
     ~LoggerEmailPlugin();
 
     // prevent copying and assignment
     DELETE_COPY_AND_ASSIGNMENT(LoggerEmailPlugin);
 
-    virtual void Log(LogLevel level, const std::string& message);
+    virtual void LogBatch(std::span<const LogRecord> records);
     virtual LogLevel MinLogLevel();
     virtual void Flush(bool stillRunning, bool force);
+    virtual std::string Name();
+    virtual std::string Status();
 
    private:
-    LogLevel m_minLogLevel;
+    std::string m_section;
+    std::atomic<LogLevel> m_minLogLevel;  // read by the logger without locking
     std::vector<std::string> m_recipients;
     std::string m_subject;
     std::string m_emailSection;
     int m_maxDelay;
     int m_maxLogs;
+    LogLevel m_urgentLevel;  // logs at or above this level are sent after m_urgentDelay, without waiting for maxDelay or maxLogs
+    int m_urgentDelay;       // milliseconds, so the logs which follow an urgent one make it into the same email
     int m_timeoutOnShutdown;
+    bool m_digest;
+    size_t m_attachmentThreshold;  // bytes of logs, above which they're sent as a compressed attachment; 0 means never
 
-    EmailSender m_emailSender;
-    std::unique_ptr<std::queue<std::string>> m_queue;
+    std::shared_ptr<EmailSender> m_emailSender;         // shared with the emails queued in the delivery pool
+    std::shared_ptr<EmailDeliveryPool> m_deliveryPool;  // shared by all plugins
+    std::unique_ptr<LogDigest> m_queue;                 // logs waiting for the next email, aggregated as they arrive
     std::uint64_t m_queueTimestamp;
+    std::uint64_t m_urgentTimestamp;  // time of the first urgent log in m_queue, 0 if there is none
+    size_t m_queueMemory;             // memory, acquired from m_memoryBudget for the lines in m_queue
+    LogMemoryBudget* m_memoryBudget;  // optional, owned by the logger
+    JsonConfig* m_cfg;
+    size_t m_subscription;  // 0 if email logging is disabled
 
-    std::mutex m_cs;  // TODO: a ga rabim? Uporabljam?
+    std::mutex m_cs;  // protects m_queue, m_queueTimestamp, m_urgentTimestamp, m_queueMemory and the settings which may change on reload
 
-    void SendEmail(std::unique_ptr<std::queue<std::string>> emailQueue, bool stillRunning);
+    // Reads the settings, which can change while the plugin is running (see OnConfigurationChanged).
+    void ConfigureLive(JsonConfig& cfg);
+    void OnConfigurationChanged(const json* oldValue, const json* newValue);
+    std::string GetSummary(const LogDigest& logs, const std::string& attachmentName, size_t compressedSize) const;
 };
 
 #endif
@@ -0,0 +1,129 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#ifndef _LOGGERSTATISTICS_H_
+#define _LOGGERSTATISTICS_H_
+
+#include <SimpleTools/SimpleTools.h>
+#include <array>
+#include <atomic>
+#include <memory>
+
+// number of regular log levels (Verbose to Fatal)
+#define LOG_LEVEL_COUNT 6
+
+// flush duration histogram buckets: < 1 ms, < 10 ms, < 100 ms, < 1 s, < 10 s, >= 10 s
+#define LOG_FLUSH_HISTOGRAM_BUCKETS 6
+
+/**
+ * Counters of a single log output (console, file or plugin), as returned in a statistics snapshot.
+ */
+struct LogSinkStatistics
+{
+    std::string name;
+    uint64_t records = 0;
+    uint64_t bytes = 0;
+    uint64_t drops = 0;
+    uint64_t flushCount = 0;
+    std::array<uint64_t, LOG_FLUSH_HISTOGRAM_BUCKETS> flushDurationHistogram = {};
+    std::string status;  // plugin specific health information, see ILoggerPlugin::Status()
+};
+
+/**
+ * Point-in-time copy of all logger statistics, see Logger::GetStatistics().
+ */
+struct LogStatisticsSnapshot
+{
+    std::array<uint64_t, LOG_LEVEL_COUNT> records = {};  // per log level
+    std::array<uint64_t, LOG_LEVEL_COUNT> bytes = {};
+    std::array<uint64_t, LOG_LEVEL_COUNT> drops = {};
+    std::vector<LogSinkStatistics> sinks;  // console, file and then all plugins in the order of registration
+    size_t memoryUsage = 0;
+    size_t peakMemoryUsage = 0;
+
+    // Returns the statistics as a single human-readable line.
+    std::string SummaryText() const;
+};
+
+/**
+ * Lock-free logger statistics.
+ *
+ * Per-level counters are updated by every logging thread, so they are sharded: each thread gets its own cache-line aligned set of
+ * counters (threads share a shard only when there are more threads than shards), which keeps the logging threads from fighting
+ * over the same cache lines. The shards are summed up when a snapshot is taken. Per-sink counters are updated by the flushing
+ * code, which is serialized anyway, so they don't need sharding.
+ *
+ * Sinks must be added before logging starts; 0 is the console and 1 is the file.
+ */
+class LoggerStatistics
+{
+   public:
+    LoggerStatistics();
+
+    // prevent copying and assignment
+    DELETE_COPY_AND_ASSIGNMENT(LoggerStatistics);
+
+    // Adds a sink and returns its index.
+    size_t AddSink(const std::string& name);
+
+    void CountRecord(size_t level, size_t bytes) noexcept;
+    void CountDrop(size_t level) noexcept;
+
+    void CountSinkRecords(size_t sink, uint64_t records, uint64_t bytes) noexcept;
+    void CountSinkDrops(size_t sink, uint64_t drops) noexcept;
+    void CountSinkFlush(size_t sink, uint64_t microseconds) noexcept;
+
+    LogStatisticsSnapshot GetSnapshot() const;
+
+   private:
+    static constexpr size_t m_shardCount = 16;
+
+    struct alignas(64) Shard
+    {
+        std::array<std::atomic<uint64_t>, LOG_LEVEL_COUNT> records = {};
+        std::array<std::atomic<uint64_t>, LOG_LEVEL_COUNT> bytes = {};
+        std::array<std::atomic<uint64_t>, LOG_LEVEL_COUNT> drops = {};
+    };
+
+    struct SinkCounters
+    {
+        std::string name;
+        std::atomic<uint64_t> records = 0;
+        std::atomic<uint64_t> bytes = 0;
+        std::atomic<uint64_t> drops = 0;
+        std::atomic<uint64_t> flushCount = 0;
+        std::array<std::atomic<uint64_t>, LOG_FLUSH_HISTOGRAM_BUCKETS> flushDurationHistogram = {};
+    };
+
+    std::array<Shard, m_shardCount> m_shards;
+    std::vector<std::unique_ptr<SinkCounters>> m_sinks;
+
+    static Shard& GetThreadShard(std::array<Shard, m_shardCount>& shards) noexcept;
+};
+
+#endif
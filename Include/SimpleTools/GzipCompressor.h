@@ -0,0 +1,67 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#ifndef _GZIPCOMPRESSOR_H_
+#define _GZIPCOMPRESSOR_H_
+
+#include <SimpleTools/SimpleTools.h>
+#include <string>
+#include <string_view>
+
+/**
+ * Streaming gzip compressor.
+ *
+ * Data is compressed as it's written, so the uncompressed data never has to be assembled in memory. The output is a
+ * standard gzip stream, readable by gunzip, 7-Zip and similar tools. Concatenated outputs are valid gzip files as well.
+ */
+class GzipCompressor
+{
+   public:
+    // The level goes from 1 (fastest) to 9 (best compression); throws std::runtime_error if zlib can't be initialized.
+    explicit GzipCompressor(int level = 6);
+    ~GzipCompressor();
+
+    // prevent copying and assignment
+    DELETE_COPY_AND_ASSIGNMENT(GzipCompressor);
+
+    void Write(std::string_view data);
+
+    // Completes the stream and returns the compressed data; the compressor can't be used afterwards.
+    std::string Finish();
+
+    uint64_t GetInputSize() const noexcept { return m_inputSize; }
+
+   private:
+    void* m_stream;  // z_stream, kept opaque so zlib headers stay out of the users
+    std::string m_output;
+    uint64_t m_inputSize;
+
+    void Deflate(std::string_view data, int flush);
+};
+
+#endif
@@ -30,12 +30,14 @@
 #define _SIMPLETOOLS_H_
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <span>
 #include <map>
 #include <filesystem>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
 
 #include <string.h>
 
@@ -117,7 +119,31 @@
 
 std::string LoadTextFile(const std::filesystem::path& filePath);
 
-void GetCurrentLocalTime(struct tm& localTime, int& milliseconds) noexcept;
+/**
+ * Read-only memory mapped file.
+ */
+class MemoryMappedFile
+{
+   public:
+    MemoryMappedFile() noexcept;
+    ~MemoryMappedFile();
+
+    // prevent copying and assignment
+    DELETE_COPY_AND_ASSIGNMENT(MemoryMappedFile);
+
+    // Maps the whole file; returns false on failure. Empty files are not mapped, but Open() succeeds.
+    bool Open(const std::filesystem::path& filePath);
+    void Close() noexcept;
+
+    std::string_view GetView() const noexcept { return std::string_view(m_data, m_size); }
+
+   private:
+    const char* m_data;
+    size_t m_size;
+};
+
+// returns the current time, split into local time and milliseconds
+std::chrono::system_clock::time_point GetCurrentLocalTime(struct tm& localTime, int& milliseconds) noexcept;
 
 uint64_t SteadyTime() noexcept;
 #define SLEEP(MILLISECONDS) std::this_thread::sleep_for(std::chrono::milliseconds(MILLISECONDS))
@@ -39,6 +39,9 @@
 
 #include <windows.h>
 #include <SimpleTools/SimpleTools.h>
+#include <JsonConfig/JsonConfig.h>
+#include <atomic>
+#include <memory>
 
 using namespace std;
 
@@ -46,6 +49,18 @@ using namespace std;
 
 #define SERVICE_CONTROL_USER 128
 
+// Settings of the svcWatchDog configuration section, see SvcWatchDog::GetSettings().
+struct SvcWatchDogSettings
+{
+    vector<string> args;
+    bool usePath;
+    bool autoStart;
+    string loadOrderGroup;
+    int restartDelay;
+    uint64_t shutdownTime;
+    int watchdogTimeout;
+};
+
 // Copyright notice: this class is based on PJ Naughter's CNTService class ( http://www.naughter.com/serv.html )
 // and contains fragments of its code. It is used here with explicit permission by the author.
 
@@ -89,9 +104,16 @@ class SvcWatchDog
     bool ReceiveUdpPing();
     void InitiateProcessShutdown();
 
+    // Returns the settings, parsed and validated by Configure() (which throws if they're invalid) and again whenever the section
+    // changes. If the configuration has been reloaded with invalid settings, the errors are logged and the previous settings are kept.
+    std::shared_ptr<const SvcWatchDogSettings> GetSettings();
+    void ApplySettings(const json* oldValue, const json* newValue);
+
     std::mutex m_cs;
 
     string m_section;
+    std::atomic<std::shared_ptr<const SvcWatchDogSettings>> m_settings;
+    size_t m_settingsSubscription;
     string m_serviceName;
     filesystem::path m_exeFile;
     filesystem::path m_exeDir;
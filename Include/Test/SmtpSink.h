@@ -0,0 +1,113 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#ifndef _SMTPSINK_H_
+#define _SMTPSINK_H_
+
+#include <SimpleTools/SimpleTools.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+/**
+ * Email, received by SmtpSink.
+ */
+struct SmtpSinkMessage
+{
+    std::string from;
+    std::vector<std::string> recipients;
+    std::string data;       // headers and body, as sent by the client (dot-stuffing removed)
+    bool secure;            // received over a STARTTLS session
+    uint64_t receivedTime;  // SteadyTime, when the end of the data was received
+};
+
+/**
+ * Minimal local SMTP server for tests and benchmarks, which records the received emails instead of delivering them.
+ *
+ * It listens on 127.0.0.1 only and serves each connection on its own thread. It understands just enough SMTP for libcurl
+ * (EHLO/HELO, STARTTLS, AUTH PLAIN/LOGIN accepting any credentials, MAIL, RCPT, DATA, RSET, NOOP, QUIT). With TLS enabled,
+ * STARTTLS is offered with a self-signed certificate, generated at start, so clients must not verify the peer (see the
+ * sslVerifyPeer SMTP option). Latency and failures can be injected at any time, to see how the clients cope.
+ *
+ * TLS support requires Botan; define SMTPSINK_NO_TLS to build the sink without it.
+ */
+class SmtpSink
+{
+   public:
+    SmtpSink() noexcept;
+    ~SmtpSink();
+
+    // prevent copying and assignment
+    DELETE_COPY_AND_ASSIGNMENT(SmtpSink);
+
+    // Starts listening; port 0 picks a free port (see GetPort()). Returns false on failure.
+    bool Start(uint16_t port = 0, bool tls = false);
+
+    // Closes the listening socket and all connections, and waits for the connection threads.
+    void Stop();
+
+    uint16_t GetPort() const noexcept;
+
+    // Delays the greeting and the reply to each received email by the given number of milliseconds.
+    void SetLatency(int latency) noexcept;
+
+    // Rejects the given share (0 to 1) of MAIL commands with a temporary error (451).
+    void SetFailureRate(double failureRate) noexcept;
+
+    size_t GetMessageCount();
+
+    // Returns the received emails and forgets them.
+    std::vector<SmtpSinkMessage> TakeMessages();
+
+    // Waits until at least count emails are received or the timeout (in milliseconds) expires; returns true in the first case.
+    bool WaitForMessages(size_t count, int timeout);
+
+   private:
+    class Connection;
+    struct TlsContext;
+
+    SOCKET m_listenSocket;
+    uint16_t m_port;
+    std::unique_ptr<TlsContext> m_tls;  // null if STARTTLS is not offered
+    std::atomic_bool m_running;
+    std::atomic_int m_latency;
+    std::atomic<double> m_failureRate;
+    std::thread m_acceptThread;
+
+    std::mutex m_cs;  // protects everything below
+    std::condition_variable m_cv;
+    std::vector<std::thread> m_connectionThreads;
+    std::vector<SOCKET> m_connectionSockets;
+    std::vector<SmtpSinkMessage> m_messages;
+
+    void AcceptThread();
+    void ConnectionThread(SOCKET socket);
+    void AddMessage(SmtpSinkMessage message);
+};
+
+#endif
@@ -0,0 +1,208 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#include <Email/EmailCircuitBreaker.h>
+#include <Logger/Logger.h>
+
+#include <map>
+
+using namespace std;
+
+EmailCircuitBreaker::EmailCircuitBreaker() noexcept
+    : m_threshold(5),
+      m_delay(60000),
+      m_state(Closed),
+      m_stateTime(0),
+      m_probing(false),
+      m_probe(0),
+      m_consecutiveFailures(0),
+      m_failures(0),
+      m_deliveries(0),
+      m_openings(0)
+{
+}
+
+shared_ptr<EmailCircuitBreaker> EmailCircuitBreaker::GetForServer(const string& serverUrl)
+{
+    static mutex cs;
+    static map<string, weak_ptr<EmailCircuitBreaker>> breakers;
+
+    const lock_guard<mutex> lock(cs);
+    auto breaker = breakers[serverUrl].lock();
+    if (!breaker)
+    {
+        breaker = make_shared<EmailCircuitBreaker>();
+        breakers[serverUrl] = breaker;
+    }
+    return breaker;
+}
+
+void EmailCircuitBreaker::Configure(int threshold, int delay) noexcept
+{
+    const lock_guard<mutex> lock(m_cs);
+    m_threshold = max(threshold, 0);
+    m_delay = max(delay, 0);
+    if (m_threshold == 0)
+    {
+        m_state = Closed;
+        m_probing = false;
+    }
+}
+
+void EmailCircuitBreaker::Refresh(uint64_t now) noexcept
+{
+    // called with the lock held; the delay is over, so let the next delivery probe the server (again)
+    if ((m_state == Open || (m_state == HalfOpen && m_probing)) && now - m_stateTime >= TOUINT64(m_delay))
+    {
+        m_state = HalfOpen;
+        m_probing = false;
+    }
+}
+
+bool EmailCircuitBreaker::TryAcquire(uint64_t& probe) noexcept
+{
+    const lock_guard<mutex> lock(m_cs);
+    const uint64_t now = SteadyTime();
+    Refresh(now);
+
+    probe = 0;
+    if (m_state == Closed)
+    {
+        return true;
+    }
+    if (m_state == HalfOpen && !m_probing)
+    {
+        m_probing = true;
+        m_stateTime = now;
+        probe = ++m_probe;
+        return true;
+    }
+    return false;
+}
+
+bool EmailCircuitBreaker::IsBlocked(uint64_t& retryTime) noexcept
+{
+    const lock_guard<mutex> lock(m_cs);
+    Refresh(SteadyTime());
+
+    if (m_state == Closed || (m_state == HalfOpen && !m_probing))
+    {
+        return false;
+    }
+    retryTime = m_stateTime + TOUINT64(m_delay);
+    return true;
+}
+
+void EmailCircuitBreaker::ReportResult(bool success, uint64_t probe) noexcept
+{
+    // the transitions are logged after unlocking, because logging takes the logger's locks and may throw
+    bool closing = false;
+    bool opening = false;
+    uint64_t consecutiveFailures = 0;
+    int delay = 0;
+    {
+        const lock_guard<mutex> lock(m_cs);
+        if (m_state == HalfOpen && (probe == 0 || probe != m_probe))
+        {
+            return;
+        }
+
+        if (success)
+        {
+            closing = m_state != Closed;
+            consecutiveFailures = m_consecutiveFailures;
+            m_deliveries++;
+            m_consecutiveFailures = 0;
+            m_state = Closed;
+            m_probing = false;
+        }
+        else
+        {
+            m_failures++;
+            m_consecutiveFailures++;
+            consecutiveFailures = m_consecutiveFailures;
+            if (m_threshold > 0 && (m_state == HalfOpen || (m_state == Closed && m_consecutiveFailures >= TOUINT64(m_threshold))))
+            {
+                if (m_state == Closed)
+                {
+                    opening = true;
+                    m_openings++;
+                }
+                m_state = Open;
+                m_stateTime = SteadyTime();
+                m_probing = false;
+            }
+        }
+        delay = m_delay;
+    }
+
+    try
+    {
+        if (closing)
+        {
+            LOGSTR(Information) << "the server is available again after " << consecutiveFailures << " failures, closing the circuit";
+        }
+        if (opening)
+        {
+            LOGSTR(Warning) << consecutiveFailures << " consecutive failures, opening the circuit for " << delay << " ms";
+        }
+    }
+    catch (...)
+    {
+        // the state is updated, the log is not worth terminating for
+    }
+}
+
+EmailCircuitBreaker::State EmailCircuitBreaker::GetState() noexcept
+{
+    const lock_guard<mutex> lock(m_cs);
+    Refresh(SteadyTime());
+    return m_state;
+}
+
+string EmailCircuitBreaker::GetStatusText()
+{
+    const lock_guard<mutex> lock(m_cs);
+    Refresh(SteadyTime());
+    return string("circuit ") + GetStateName(m_state) + ", " + to_string(m_consecutiveFailures) + " consecutive failures, " +
+           to_string(m_failures) + " failures, " + to_string(m_deliveries) + " deliveries, opened " + to_string(m_openings) + " times";
+}
+
+const char* EmailCircuitBreaker::GetStateName(State state) noexcept
+{
+    switch (state)
+    {
+        case Closed:
+            return "closed";
+        case Open:
+            return "open";
+        case HalfOpen:
+            return "half-open";
+    }
+    return "unknown";
+}
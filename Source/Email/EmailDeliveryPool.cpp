@@ -0,0 +1,543 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#include <curl/curl.h>
+#include <Email/EmailDeliveryPool.h>
+#include <Logger/Logger.h>
+
+#include <algorithm>
+
+using namespace std;
+
+EmailDeliveryPool::EmailDeliveryPool(size_t maxConcurrentDeliveries, size_t maxPendingEmails, unique_ptr<EmailSpool> spool,
+                                     int timeoutOnShutdown)
+    : m_maxConcurrentDeliveries(max<size_t>(maxConcurrentDeliveries, 1)),
+      m_maxPendingEmails(max<size_t>(maxPendingEmails, 1)),
+      m_spool(std::move(spool)),
+      m_timeoutOnShutdown(timeoutOnShutdown),
+      m_multi(curl_multi_init()),
+      m_activeDeliveries(0),
+      m_stopping(false),
+      m_delivered(0),
+      m_failed(0),
+      m_merged(0),
+      m_dropped(0),
+      m_spooled(0),
+      m_retried(0)
+{
+    if (m_multi)
+    {
+        m_thread = thread(&EmailDeliveryPool::Thread, this);
+    }
+    else
+    {
+        // the emails will only be spooled (if possible)
+        LOGSTR(Error) << "failed to initialize curl multi handle";
+        m_stopping = true;
+    }
+
+    LOGSTR() << "maxConcurrentDeliveries=" << m_maxConcurrentDeliveries << ", maxPendingEmails=" << m_maxPendingEmails
+             << ", spool=" << BOOL2STR(m_spool) << ", timeoutOnShutdown=" << m_timeoutOnShutdown;
+}
+
+EmailDeliveryPool::~EmailDeliveryPool()
+{
+    // the owners are gone by now, and they don't wait for their last emails themselves; one deadline for all of them
+    Shutdown(m_timeoutOnShutdown);
+    if (m_multi)
+    {
+        curl_multi_cleanup(m_multi);
+    }
+}
+
+void EmailDeliveryPool::WakeUp()
+{
+    // interrupts curl_multi_poll in the delivery thread (or makes the next one return immediately); safe to call from any thread
+    if (m_multi)
+    {
+        curl_multi_wakeup(m_multi);
+    }
+}
+
+void EmailDeliveryPool::RegisterOwner(const void* owner, const string& name, shared_ptr<EmailSender> sender)
+{
+    {
+        const lock_guard<mutex> lock(m_cs);
+        erase_if(m_owners, [&](const Owner& o) { return o.owner == owner || o.name == name; });
+        m_owners.push_back({owner, name, std::move(sender)});
+    }
+
+    // the spooled emails of this owner may be retried now
+    WakeUp();
+}
+
+void EmailDeliveryPool::ReportOrphans()
+{
+    if (!m_spool)
+    {
+        return;
+    }
+
+    auto owners = m_spool->GetOwners();
+    {
+        const lock_guard<mutex> lock(m_cs);
+        erase_if(owners, [this](const auto& owner) { return ranges::find(m_owners, owner.first, &Owner::name) != m_owners.end(); });
+    }
+    for (const auto& [name, count] : owners)
+    {
+        LOGSTR(Warning) << count << " spooled emails of " << name << " will not be delivered, because it's not configured"
+                        << (m_spool->GetMaxAge() > 0 ? "; they are discarded after " + to_string(m_spool->GetMaxAge()) + " ms" : "");
+    }
+}
+
+bool EmailDeliveryPool::SpoolEmail(const Email& email, int attempts)
+{
+    return m_spool && !email.ownerName.empty() &&
+           m_spool->Store(email.ownerName, email.subject, email.recipients, email.bodyParts, email.attachments, attempts);
+}
+
+void EmailDeliveryPool::SpoolOrDrop(const Email& email, const char* reason)
+{
+    // called without the lock, since writing the spool file may take a while
+    const bool spooled = SpoolEmail(email, 0);
+    if (!spooled)
+    {
+        LOGSTR(Error) << reason << ", dropping the email to " << JoinStrings(email.recipients, ",");
+    }
+
+    const lock_guard<mutex> lock(m_cs);
+    (spooled ? m_spooled : m_dropped)++;
+}
+
+void EmailDeliveryPool::ReleaseOwner(const void* owner)
+{
+    // called with the lock held; the owner may be listed more than once (being spooled while its previous email is delivered)
+    const auto it = ranges::find(m_busyOwners, owner);
+    if (it != m_busyOwners.end())
+    {
+        m_busyOwners.erase(it);
+    }
+}
+
+void EmailDeliveryPool::Submit(const void* owner, shared_ptr<EmailSender> sender, const string& subject, const vector<string>& recipients,
+                               shared_ptr<const IEmailBody> body, int timeout, vector<EmailAttachment> attachments)
+{
+    // the logs of the delivery (here of the spool) are not sent by email
+    const PluginDeliveryScope deliveryScope;
+
+    // the email which can't be queued is spooled (or dropped) once we unlock
+    Email overflow{};
+    const char* overflowReason = nullptr;
+    bool stopped;
+    {
+        const lock_guard<mutex> lock(m_cs);
+        const auto registered = ranges::find(m_owners, owner, &Owner::owner);
+        Email email{owner, registered != m_owners.end() ? registered->name : "", std::move(sender), subject, recipients,
+                    {std::move(body)}, timeout, std::move(attachments), 0};
+
+        stopped = m_stopping;
+        if (stopped)
+        {
+            overflow = std::move(email);
+            overflowReason = "the delivery pool is stopped";
+        }
+        else
+        {
+            if (m_queue.size() >= m_maxPendingEmails)
+            {
+                // full - merge the email into the last queued one of the same owner, if there is one
+                const auto it = find_if(m_queue.rbegin(), m_queue.rend(),
+                                        [&](const Email& queued) { return queued.owner == owner && queued.sender == email.sender; });
+                if (it != m_queue.rend())
+                {
+                    ranges::move(email.bodyParts, back_inserter(it->bodyParts));
+                    ranges::move(email.attachments, back_inserter(it->attachments));
+                    if (timeout > 0 && (it->timeout <= 0 || timeout < it->timeout))
+                    {
+                        // the shorter (shutdown) timeout wins
+                        it->timeout = timeout;
+                    }
+                    m_merged++;
+                    return;
+                }
+
+                // move the oldest one to the spool (or drop it if we can't); until it's there, its owner is busy, so the
+                // newer emails of the owner can't overtake it
+                overflow = std::move(m_queue.front());
+                overflowReason = "too many pending emails";
+                m_queue.pop_front();
+                m_busyOwners.push_back(overflow.owner);
+            }
+            m_queue.push_back(std::move(email));
+        }
+    }
+
+    if (overflowReason)
+    {
+        SpoolOrDrop(overflow, overflowReason);
+    }
+    if (!stopped)
+    {
+        if (overflowReason)
+        {
+            const lock_guard<mutex> lock(m_cs);
+            ReleaseOwner(overflow.owner);
+        }
+        WakeUp();
+    }
+}
+
+bool EmailDeliveryPool::Drain(int timeout)
+{
+    unique_lock<mutex> lock(m_cs);
+    return m_cv.wait_for(lock, chrono::milliseconds(max(timeout, 0)), [this]() { return m_queue.empty() && m_activeDeliveries == 0; });
+}
+
+void EmailDeliveryPool::Shutdown(int timeout)
+{
+    const PluginDeliveryScope deliveryScope;
+    if (!m_thread.joinable())
+    {
+        return;
+    }
+
+    const bool drained = Drain(timeout);
+
+    // The delivery thread aborts (removes from the multi handle) the deliveries still in progress and exits right away; it
+    // never blocks anywhere but in curl_multi_poll, which WakeUp interrupts, so the join doesn't depend on the SMTP servers.
+    // Nothing is left running after this, so the logger and the senders may be destroyed next.
+    {
+        const lock_guard<mutex> lock(m_cs);
+        m_stopping = true;
+    }
+    WakeUp();
+    m_thread.join();
+
+    // keep the queued emails for the next run, if possible; the spool files are written without the lock
+    deque<Email> queue;
+    {
+        const lock_guard<mutex> lock(m_cs);
+        queue.swap(m_queue);
+    }
+    size_t spooled = 0;
+    for (const auto& email : queue)
+    {
+        if (SpoolEmail(email, 0))
+        {
+            spooled++;
+        }
+    }
+    if (spooled < queue.size())
+    {
+        LOGSTR(Error) << "shutting down, " << queue.size() - spooled << " queued emails will not be delivered";
+    }
+
+    const lock_guard<mutex> lock(m_cs);
+    m_spooled += spooled;
+    m_dropped += queue.size() - spooled;
+    LOGSTR() << "delivered=" << m_delivered << ", failed=" << m_failed << ", merged=" << m_merged << ", dropped=" << m_dropped
+             << ", spooled=" << m_spooled << ", retried=" << m_retried
+             << (m_spool ? ", left in spool=" + to_string(m_spool->GetCount()) : "") << (drained ? "" : ", timed out while draining");
+}
+
+size_t EmailDeliveryPool::GetPendingCount()
+{
+    const lock_guard<mutex> lock(m_cs);
+    return m_queue.size() + m_activeDeliveries;
+}
+
+bool EmailDeliveryPool::IsOwnerAvailable(const string& name) const
+{
+    // the spooled emails of owners which are not registered (yet), busy or unable to reach their server have to wait
+    const auto it = ranges::find(m_owners, name, &Owner::name);
+    uint64_t retryTime = 0;
+    return it != m_owners.end() && ranges::find(m_busyOwners, it->owner) == m_busyOwners.end() &&
+           !it->sender->GetCircuitBreaker().IsBlocked(retryTime);
+}
+
+bool EmailDeliveryPool::TakeSpooledEmail(Email& email)
+{
+    // called with the lock held
+    string name;
+    const uint64_t sequence = m_spool->TakeDue([this](const string& owner) { return IsOwnerAvailable(owner); }, name);
+    if (sequence == 0)
+    {
+        return false;
+    }
+
+    // the content is loaded later, without holding the lock
+    const auto& owner = *ranges::find(m_owners, name, &Owner::name);
+    email = {owner.owner, name, owner.sender, "", {}, {}, 0, {}, sequence};
+    return true;
+}
+
+bool EmailDeliveryPool::TakeEmail(Email& email)
+{
+    // called with the lock held; the spooled emails which are due come first, because they're older than the queued emails
+    // of the same owner, then the oldest queued email whose owner isn't busy with another delivery (and whose server is not
+    // known to be down)
+    if (!m_spool || !TakeSpooledEmail(email))
+    {
+        uint64_t retryTime = 0;
+        const auto it = ranges::find_if(m_queue,
+                                        [&](const Email& queued)
+                                        {
+                                            return ranges::find(m_busyOwners, queued.owner) == m_busyOwners.end() &&
+                                                   !queued.sender->GetCircuitBreaker().IsBlocked(retryTime);
+                                        });
+        if (it == m_queue.end())
+        {
+            return false;
+        }
+        email = std::move(*it);
+        m_queue.erase(it);
+    }
+
+    m_busyOwners.push_back(email.owner);
+    m_activeDeliveries++;
+    return true;
+}
+
+void EmailDeliveryPool::StartDelivery(vector<Delivery>& deliveries, Email email)
+{
+    auto& delivery = deliveries.emplace_back(Delivery{std::move(email), nullptr});
+    auto& e = delivery.email;
+
+    bool loaded = e.spoolSequence == 0;
+    if (!loaded)
+    {
+        // damaged emails are removed from the spool
+        string body;
+        loaded = m_spool->Load(e.spoolSequence, e.subject, e.recipients, body, e.attachments);
+        e.bodyParts = {make_shared<StringEmailBody>(std::move(body))};
+    }
+
+    if (loaded && !e.sender->GetCircuitBreaker().TryAcquire(delivery.probe))
+    {
+        // another email got the probe of a half-open circuit first
+        PostponeDelivery(delivery);
+        deliveries.pop_back();
+        return;
+    }
+
+    if (loaded)
+    {
+        try
+        {
+            // the body parts are streamed, without being joined
+            vector<const IEmailBody*> bodyParts;
+            ranges::transform(e.bodyParts, back_inserter(bodyParts), [](const auto& part) { return part.get(); });
+            delivery.transfer = e.sender->StartTransfer(e.subject, bodyParts, e.recipients, "", e.timeout, e.attachments);
+        }
+        catch (const std::exception& e)
+        {
+            LOGSTR(Error) << "exception while preparing email: " << e.what();
+        }
+    }
+
+    if (delivery.transfer)
+    {
+        curl_multi_add_handle(m_multi, delivery.transfer->GetHandle());
+    }
+    else
+    {
+        if (loaded)
+        {
+            e.sender->GetCircuitBreaker().ReportResult(false, delivery.probe);
+        }
+        CompleteDelivery(delivery, false);
+        deliveries.pop_back();
+    }
+}
+
+void EmailDeliveryPool::CompleteDelivery(Delivery& delivery, bool success)
+{
+    const auto& email = delivery.email;
+    if (email.spoolSequence != 0)
+    {
+        // keep it in the spool until it's delivered
+        if (success)
+        {
+            m_spool->Remove(email.spoolSequence);
+        }
+        else
+        {
+            m_spool->Reschedule(email.spoolSequence);
+        }
+    }
+    const bool spooled = !success && email.spoolSequence == 0 && SpoolEmail(email, 1);
+
+    const lock_guard<mutex> lock(m_cs);
+    ReleaseOwner(email.owner);
+    m_activeDeliveries--;
+    (success ? m_delivered : m_failed)++;
+    if (success && email.spoolSequence != 0)
+    {
+        m_retried++;
+    }
+    if (spooled)
+    {
+        m_spooled++;
+    }
+    m_cv.notify_all();
+}
+
+void EmailDeliveryPool::PostponeDelivery(Delivery& delivery)
+{
+    auto& email = delivery.email;
+    if (email.spoolSequence != 0)
+    {
+        m_spool->Release(email.spoolSequence);
+    }
+
+    const lock_guard<mutex> lock(m_cs);
+    ReleaseOwner(email.owner);
+    m_activeDeliveries--;
+    if (email.spoolSequence == 0)
+    {
+        // back to the front of the queue, so the order is preserved
+        m_queue.push_front(std::move(email));
+    }
+    m_cv.notify_all();
+}
+
+uint64_t EmailDeliveryPool::GetCircuitRetryTime() const
+{
+    // called with the lock held; returns the earliest time an open circuit lets a probe through, UINT64_MAX if none is open
+    uint64_t next = UINT64_MAX;
+    for (const auto& owner : m_owners)
+    {
+        uint64_t retryTime = 0;
+        if (owner.sender->GetCircuitBreaker().IsBlocked(retryTime))
+        {
+            next = min(next, retryTime);
+        }
+    }
+    return next;
+}
+
+void EmailDeliveryPool::Thread()
+{
+    // nothing this thread logs (including the logs of the senders, the circuit breakers and the spool) is sent by email
+    const PluginDeliveryScope deliveryScope;
+
+    // libcurl reads the bodies and the attachments directly from the emails; they live on the heap, so moving a Delivery
+    // object around is fine
+    vector<Delivery> deliveries;
+
+    unique_lock<mutex> lock(m_cs);
+    while (!m_stopping)
+    {
+        // start new deliveries, up to the limit
+        Email email;
+        while (deliveries.size() < m_maxConcurrentDeliveries && TakeEmail(email))
+        {
+            lock.unlock();
+            StartDelivery(deliveries, std::move(email));
+            lock.lock();
+        }
+        lock.unlock();
+
+        // let libcurl do its work, then take care of the finished transfers
+        int running = 0;
+        curl_multi_perform(m_multi, &running);
+
+        bool completed = false;
+        int messages = 0;
+        while (const auto message = curl_multi_info_read(m_multi, &messages))
+        {
+            if (message->msg != CURLMSG_DONE)
+            {
+                continue;
+            }
+
+            // the message is only valid until the handle is removed
+            const auto handle = message->easy_handle;
+            const auto result = message->data.result;
+            const auto it = ranges::find(deliveries, static_cast<void*>(handle), [](const Delivery& d) { return d.transfer->GetHandle(); });
+            curl_multi_remove_handle(m_multi, handle);
+            if (it == deliveries.end())
+            {
+                continue;
+            }
+
+            bool retry = false;
+            const int res = it->email.sender->FinishTransfer(*it->transfer, result, retry);
+            if (retry)
+            {
+                curl_multi_add_handle(m_multi, handle);
+                continue;
+            }
+            it->email.sender->GetCircuitBreaker().ReportResult(res == CURLE_OK, it->probe);
+            CompleteDelivery(*it, res == CURLE_OK);
+            deliveries.erase(it);
+            completed = true;
+        }
+
+        if (m_spool)
+        {
+            m_spool->Expire();
+        }
+
+        lock.lock();
+        if (completed)
+        {
+            // the owners are free again, their next emails can be started right away
+            continue;
+        }
+
+        // wait for network activity, a new email, the next retry from the spool or the next circuit breaker probe (if there is
+        // a free slot for it)
+        uint64_t nextAttemptTime = UINT64_MAX;
+        if (deliveries.size() < m_maxConcurrentDeliveries)
+        {
+            nextAttemptTime = GetCircuitRetryTime();
+            if (m_spool)
+            {
+                nextAttemptTime =
+                    min(nextAttemptTime, m_spool->GetNextAttemptTime([this](const string& name) { return IsOwnerAvailable(name); }));
+            }
+        }
+        lock.unlock();
+        const uint64_t now = SteadyTime();
+        const uint64_t wait = nextAttemptTime > now ? min<uint64_t>(nextAttemptTime - now, 60000) : 0;
+        curl_multi_poll(m_multi, nullptr, 0, TOINT(wait), nullptr);
+        lock.lock();
+    }
+    lock.unlock();
+
+    // abort the deliveries still in progress; their emails are spooled (if possible)
+    for (auto& delivery : deliveries)
+    {
+        LOGSTR(Warning) << "aborting the delivery to " << JoinStrings(delivery.email.recipients, ",");
+        // on removal, libcurl says QUIT to the server and waits for the reply, up to the transfer timeout; let it expire right away
+        curl_easy_setopt(delivery.transfer->GetHandle(), CURLOPT_TIMEOUT_MS, 1L);
+        curl_multi_remove_handle(m_multi, delivery.transfer->GetHandle());
+        CompleteDelivery(delivery, false);
+    }
+}
@@ -37,9 +37,123 @@ using namespace std;
 
 EmailSender* EmailSender::m_instance = nullptr;
 
-EmailSender::EmailSender() noexcept : m_sslFlag(CURLUSESSL_ALL), m_timeout(120000) {}
+namespace
+{
+// Body which only references a string, owned by somebody else.
+class StringViewEmailBody : public IEmailBody
+{
+   public:
+    explicit StringViewEmailBody(string_view text) : m_text(text) {}
+
+    size_t GetPieceCount() const override { return 1; }
+    string_view GetPiece(size_t, string&) const override { return m_text; }
+
+   private:
+    string_view m_text;
+};
+
+// Feeds the body parts to libcurl, piece by piece, so libcurl doesn't need its own copy of the whole body.
+class EmailBodyReader
+{
+   public:
+    explicit EmailBodyReader(vector<const IEmailBody*> parts) : m_parts(std::move(parts)) { Rewind(); }
+
+    // the total size, which libcurl needs in advance; only the small rendered pieces are created, one by one
+    curl_off_t GetSize() const
+    {
+        curl_off_t size = 0;
+        string scratch;
+        for (const auto part : m_parts)
+        {
+            for (size_t i = 0; i < part->GetPieceCount(); i++)
+            {
+                size += part->GetPiece(i, scratch).length();
+            }
+        }
+        return size;
+    }
+
+    void Rewind()
+    {
+        m_part = 0;
+        m_piece = 0;
+        m_current = {};
+    }
+
+    size_t Read(char* buffer, size_t size)
+    {
+        size_t written = 0;
+        while (written < size)
+        {
+            if (m_current.empty())
+            {
+                // move to the next piece
+                while (m_part < m_parts.size() && m_piece >= m_parts[m_part]->GetPieceCount())
+                {
+                    m_part++;
+                    m_piece = 0;
+                }
+                if (m_part >= m_parts.size())
+                {
+                    break;
+                }
+                m_current = m_parts[m_part]->GetPiece(m_piece++, m_scratch);
+                continue;
+            }
+
+            const size_t length = min(size - written, m_current.length());
+            memcpy(buffer + written, m_current.data(), length);
+            written += length;
+            m_current.remove_prefix(length);
+        }
+        return written;
+    }
+
+    static size_t ReadCallback(char* buffer, size_t size, size_t nitems, void* reader)
+    {
+        return static_cast<EmailBodyReader*>(reader)->Read(buffer, size * nitems);
+    }
 
-EmailSender::~EmailSender() = default;
+    static int SeekCallback(void* reader, curl_off_t offset, int origin)
+    {
+        // libcurl only needs to start over (for example when the server asks for authentication first)
+        if (offset != 0 || origin != SEEK_SET)
+        {
+            return CURL_SEEKFUNC_CANTSEEK;
+        }
+        static_cast<EmailBodyReader*>(reader)->Rewind();
+        return CURL_SEEKFUNC_OK;
+    }
+
+   private:
+    vector<const IEmailBody*> m_parts;
+    size_t m_part;
+    size_t m_piece;
+    string_view m_current;  // the rest of the current piece
+    string m_scratch;
+};
+}  // namespace
+
+EmailSender::EmailSender() noexcept
+    : m_sslFlag(CURLUSESSL_ALL),
+      m_sslVerifyPeer(true),
+      m_timeout(120000),
+      m_idleTimeout(60000),
+      m_multi(nullptr),
+      m_circuitBreaker(make_shared<EmailCircuitBreaker>()),
+      m_cfg(nullptr),
+      m_subscription(0)
+{
+}
+
+EmailSender::~EmailSender()
+{
+    if (m_subscription)
+    {
+        m_cfg->Unsubscribe(m_subscription);
+    }
+    CloseConnection();
+}
 
 EmailSender* EmailSender::GetInstance() noexcept { return m_instance; }
 
@@ -49,6 +163,9 @@ void EmailSender::Configure(JsonConfig& cfg, const string& section)
 {
     LOGSTR() << "reading configuration from section: " << section;
 
+    // the connection might belong to the previous configuration
+    CloseConnection();
+
     m_smtpServerUrl = Crypto.GetPossiblyEncryptedConfigurationString(Cfg, section, "smtpServerUrl", "");
     LOGSTR() << "smtpServerUrl=" << m_smtpServerUrl;
 
@@ -64,14 +181,66 @@ void EmailSender::Configure(JsonConfig& cfg, const string& section)
     m_sslFlag = cfg.GetNumber(section, "sslFlag", m_sslFlag);
     LOGSTR() << "sslFlag=" << m_sslFlag;
 
+    m_sslVerifyPeer = cfg.GetBool(section, "sslVerifyPeer", m_sslVerifyPeer);
+    LOGSTR() << "sslVerifyPeer=" << BOOL2STR(m_sslVerifyPeer);
+
     m_username = Crypto.GetPossiblyEncryptedConfigurationString(Cfg, section, "username", "");
     LOGSTR() << "username=" << m_username;
 
     m_password = Crypto.GetPossiblyEncryptedConfigurationString(Cfg, section, "password", "");
     LOGSTR() << "password=" << (m_password.empty() ? "<none>" : "<non-empty>");
 
-    m_timeout = cfg.GetNumber(section, "timeout", m_timeout);
-    LOGSTR() << "timeout=" << m_timeout;
+    // all senders of the same server share its health state
+    m_circuitBreaker = EmailCircuitBreaker::GetForServer(m_smtpServerUrl);
+    ConfigureLive(cfg, section);
+
+    // the timeouts and the circuit breaker settings are applied again whenever the section changes
+    if (m_subscription)
+    {
+        m_cfg->Unsubscribe(m_subscription);
+    }
+    m_cfg = &cfg;
+    m_section = section;
+    m_subscription =
+        cfg.Subscribe(section, [this](const json* oldValue, const json* newValue) { OnConfigurationChanged(oldValue, newValue); });
+}
+
+void EmailSender::ConfigureLive(JsonConfig& cfg, const string& section)
+{
+    m_timeout = cfg.GetNumber(section, "timeout", 120000, ConfigUnit::Milliseconds);
+    m_idleTimeout = cfg.GetNumber(section, "idleTimeout", 60000, ConfigUnit::Milliseconds);
+    LOGSTR() << "timeout=" << m_timeout << ", idleTimeout=" << m_idleTimeout;
+
+    const int circuitBreakerThreshold = cfg.GetNumber(section, "circuitBreakerThreshold", 5);
+    const int circuitBreakerDelay = cfg.GetNumber(section, "circuitBreakerDelay", 60000, ConfigUnit::Milliseconds);
+    m_circuitBreaker->Configure(circuitBreakerThreshold, circuitBreakerDelay);
+    LOGSTR() << "circuitBreakerThreshold=" << circuitBreakerThreshold << ", circuitBreakerDelay=" << circuitBreakerDelay;
+}
+
+void EmailSender::OnConfigurationChanged(const json* oldValue, const json* newValue)
+{
+    const PluginDeliveryScope deliveryScope;
+    LOGSTR(Information) << "applying the changes of section " << m_section;
+    ConfigureLive(*m_cfg, m_section);
+
+    // the server and the credentials would need a new connection and a new circuit breaker
+    const auto restartKeys =
+        JsonConfig::GetChangedKeys(oldValue, newValue, {"timeout", "idleTimeout", "circuitBreakerThreshold", "circuitBreakerDelay"});
+    if (!restartKeys.empty())
+    {
+        LOGSTR(Warning) << "changes of " << m_section << "." << JoinStrings(restartKeys, ", ") << " take effect after a restart";
+    }
+}
+
+void EmailSender::CloseConnection() noexcept
+{
+    const lock_guard<mutex> lock(m_cs);
+    if (m_multi)
+    {
+        // this is when curl sends the QUIT command
+        curl_multi_cleanup(m_multi);
+        m_multi = nullptr;
+    }
 }
 
 /*
@@ -104,27 +273,25 @@ size_t payload_source(char* ptr, size_t size, size_t nmemb, void* userp)
 }
 */
 
-int EmailSender::SendSimpleEmail(const string& subject, const string& utf8body, const vector<string>& toAddresses,
-                                 const string& fromAddress, int timeout)
+void* EmailSender::CreateCurlHandle() const
 {
-    const string toString = JoinStrings(toAddresses, ",");
-    LOGSTR(Information) << "sending email to " << toString;
-
-    // TODO: verify that the addresses are valid email address, verify that subject is syntatically correct, etc.
-    auto actualFromAddress = fromAddress.empty() ? m_defaultSourceAddress : fromAddress;
-
+    // the options which stay the same for all emails
     auto curl = curl_easy_init();
     if (!curl)
     {
         LOGSTR(Error) << "failed to initialize curl";
-        return CURLE_FAILED_INIT;
+        return nullptr;
     }
 
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)(timeout > 0 ? timeout : m_timeout));
-
     curl_easy_setopt(curl, CURLOPT_URL, m_smtpServerUrl.c_str());
 
     curl_easy_setopt(curl, CURLOPT_USE_SSL, m_sslFlag);
+    if (!m_sslVerifyPeer)
+    {
+        // for test servers with self-signed certificates only
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    }
 
     if (!m_username.empty())
     {
@@ -136,74 +303,253 @@ int EmailSender::SendSimpleEmail(const string& subject, const string& utf8body,
         curl_easy_setopt(curl, CURLOPT_PASSWORD, m_password.c_str());
     }
 
+    return curl;
+}
+
+int EmailSender::SendSimpleEmail(const string& subject, const string& utf8body, const vector<string>& toAddresses,
+                                 const string& fromAddress, int timeout, const vector<EmailAttachment>& attachments)
+{
+    const StringViewEmailBody body(utf8body);
+    return SendEmail(subject, {&body}, toAddresses, fromAddress, timeout, attachments);
+}
+
+int EmailSender::SendEmail(const string& subject, const vector<const IEmailBody*>& bodyParts, const vector<string>& toAddresses,
+                           const string& fromAddress, int timeout, const vector<EmailAttachment>& attachments)
+{
+    // the logs of the delivery (also of the circuit breaker) are not sent by email
+    const PluginDeliveryScope deliveryScope;
+
+    uint64_t probe;
+    if (!m_circuitBreaker->TryAcquire(probe))
+    {
+        LOGSTR(Warning) << "the SMTP server is unavailable (circuit open), not sending email to " << JoinStrings(toAddresses, ",");
+        return CURLE_COULDNT_CONNECT;
+    }
+
+    // TODO: verify that the addresses are valid email address, verify that subject is syntatically correct, etc.
+    int res = CURLE_FAILED_INIT;
+    auto transfer = StartTransfer(subject, bodyParts, toAddresses, fromAddress, timeout, attachments);
+    if (transfer)
+    {
+        // The kept connections can only deliver one email at a time. If they're busy (for example when a previous delivery is
+        // still in progress during shutdown), we use a temporary connection instead of waiting.
+        const unique_lock<mutex> lock(m_cs, try_to_lock);
+        bool retry = true;
+        while (retry)
+        {
+            res = lock.owns_lock() ? Perform(*transfer) : curl_easy_perform(transfer->GetHandle());
+            res = FinishTransfer(*transfer, res, retry);
+        }
+    }
+
+    m_circuitBreaker->ReportResult(res == CURLE_OK, probe);
+    return res;
+}
+
+// Runs the transfer on our multi handle, so the connection stays in its connection cache afterwards; m_cs must be locked.
+int EmailSender::Perform(EmailTransfer& transfer)
+{
+    if (!m_multi)
+    {
+        m_multi = curl_multi_init();
+        if (!m_multi)
+        {
+            LOGSTR(Error) << "failed to initialize curl multi handle";
+            return CURLE_FAILED_INIT;
+        }
+    }
+
+    auto multi = static_cast<CURLM*>(m_multi);
+    auto curl = static_cast<CURL*>(transfer.GetHandle());
+    if (curl_multi_add_handle(multi, curl) != CURLM_OK)
+    {
+        return CURLE_FAILED_INIT;
+    }
+
+    int res = CURLE_FAILED_INIT;
+    int running = 1;
+    while (running > 0 && curl_multi_perform(multi, &running) == CURLM_OK)
+    {
+        if (running > 0)
+        {
+            curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+        }
+    }
+
+    int queued;
+    while (const auto message = curl_multi_info_read(multi, &queued))
+    {
+        if (message->msg == CURLMSG_DONE && message->easy_handle == curl)
+        {
+            res = message->data.result;
+        }
+    }
+
+    curl_multi_remove_handle(multi, curl);
+    return res;
+}
+
+void EmailSender::LogResult(int result, const string& toString, uint64_t startTime, long newConnections) const
+{
+    if (result == CURLE_OK)
+    {
+        LOGSTR(Information) << "email sent successfully to " << toString << " in " << SteadyTime() - startTime << " ms ("
+                            << (newConnections > 0 ? "new" : "reused") << " connection)";
+    }
+    else
+    {
+        LOGSTR(Error) << "email delivery failed with " << result << " while sending to " << toString << " ("
+                      << curl_easy_strerror((CURLcode)result) << ")";
+    }
+}
+
+// everything a transfer needs until it's finished
+struct EmailTransfer::Data
+{
+    CURL* curl = nullptr;
+    curl_slist* recipients = nullptr;
+    curl_slist* headers = nullptr;
+    curl_mime* mime = nullptr;
+    unique_ptr<EmailBodyReader> bodyReader;
+    vector<StringViewEmailBody> attachmentBodies;
+    vector<EmailBodyReader> attachmentReaders;
+    string toString;
+    uint64_t startTime = 0;
+    bool retried = false;
+};
+
+EmailTransfer::EmailTransfer(unique_ptr<Data> data) noexcept : m_data(std::move(data)) {}
+
+EmailTransfer::~EmailTransfer()
+{
+    curl_easy_cleanup(m_data->curl);
+
+    // Free the lists
+    curl_slist_free_all(m_data->recipients);
+    curl_slist_free_all(m_data->headers);
+    curl_mime_free(m_data->mime);
+}
+
+void* EmailTransfer::GetHandle() const noexcept { return m_data->curl; }
+
+void EmailSender::SetupTransfer(EmailTransfer& transfer, const string& subject, const vector<const IEmailBody*>& bodyParts,
+                                const vector<string>& toAddresses, const string& fromAddress, int timeout,
+                                const vector<EmailAttachment>& attachments) const
+{
+    auto& data = *transfer.m_data;
+    auto curl = data.curl;
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)(timeout > 0 ? timeout : m_timeout.load()));
+
     // Note that this option is not strictly required, omitting it results in
     // libcurl sending the MAIL FROM command with empty sender data. All
     // autoresponses should have an empty reverse-path, and should be directed
     // to the address in the reverse-path which triggered them. Otherwise,
     // they could cause an endless loop. See RFC 5321 Section 4.5.5 for more
     // details.
-    curl_easy_setopt(curl, CURLOPT_MAIL_FROM, actualFromAddress.c_str());
+    curl_easy_setopt(curl, CURLOPT_MAIL_FROM, fromAddress.c_str());
 
     // Add recipients
-    curl_slist* recipients = nullptr;
     for (const auto& toAddress : toAddresses)
     {
-        recipients = curl_slist_append(recipients, toAddress.c_str());
+        data.recipients = curl_slist_append(data.recipients, toAddress.c_str());
     }
-    curl_easy_setopt(curl, CURLOPT_MAIL_RCPT, recipients);
+    curl_easy_setopt(curl, CURLOPT_MAIL_RCPT, data.recipients);
 
     // Add email headers (including Subject)
-    auto headers = curl_slist_append(nullptr, ("Subject: " + subject).c_str());
-    headers = curl_slist_append(headers, ("From: " + actualFromAddress).c_str());
-    headers = curl_slist_append(headers, ("To: " + toString).c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    data.headers = curl_slist_append(nullptr, ("Subject: " + subject).c_str());
+    data.headers = curl_slist_append(data.headers, ("From: " + fromAddress).c_str());
+    data.headers = curl_slist_append(data.headers, ("To: " + JoinStrings(toAddresses, ",")).c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, data.headers);
 
     // Create MIME message by default
-    auto mime = curl_mime_init(curl);
+    data.mime = curl_mime_init(curl);
 
     // Add email body
-    auto part = curl_mime_addpart(mime);
+    auto part = curl_mime_addpart(data.mime);
 
     curl_mime_type(part, "text/plain; charset=UTF-8");
     curl_mime_type(part, "text/plain");
 
-    curl_mime_data(part, utf8body.c_str(), CURL_ZERO_TERMINATED);
+    // the body is streamed, libcurl reads it while sending
+    data.bodyReader = make_unique<EmailBodyReader>(bodyParts);
+    curl_mime_data_cb(part, data.bodyReader->GetSize(), &EmailBodyReader::ReadCallback, &EmailBodyReader::SeekCallback, nullptr,
+                      data.bodyReader.get());
 
-    // Add attachment - should we have any
-    // part = curl_mime_addpart(mime);
-    // curl_mime_encoder(part, "base64");
-    // curl_mime_filedata(part, "s:\\temp\\bronson.gif");
+    // Add attachments, should we have any; they are streamed as well
+    data.attachmentBodies.reserve(attachments.size());
+    data.attachmentReaders.reserve(attachments.size());
+    for (const auto& attachment : attachments)
+    {
+        auto& reader = data.attachmentReaders.emplace_back(vector<const IEmailBody*>{&data.attachmentBodies.emplace_back(attachment.data)});
+        part = curl_mime_addpart(data.mime);
+        curl_mime_filename(part, attachment.fileName.c_str());
+        curl_mime_type(part, attachment.contentType.c_str());
+        curl_mime_encoder(part, "base64");
+        curl_mime_data_cb(part, reader.GetSize(), &EmailBodyReader::ReadCallback, &EmailBodyReader::SeekCallback, nullptr, &reader);
+    }
 
-    curl_easy_setopt(curl, CURLOPT_MIMEPOST, mime);
+    curl_easy_setopt(curl, CURLOPT_MIMEPOST, data.mime);
+}
+
+unique_ptr<EmailTransfer> EmailSender::StartTransfer(const string& subject, const vector<const IEmailBody*>& bodyParts,
+                                                     const vector<string>& toAddresses, const string& fromAddress, int timeout,
+                                                     const vector<EmailAttachment>& attachments) const
+{
+    const string toString = JoinStrings(toAddresses, ",");
+    LOGSTR(Information) << "sending email to " << toString;
+
+    auto curl = CreateCurlHandle();
+    if (!curl)
+    {
+        return nullptr;
+    }
 
-    // Send the message
-    const auto res = curl_easy_perform(curl);
+    unique_ptr<EmailTransfer> transfer(new EmailTransfer(make_unique<EmailTransfer::Data>()));
+    auto& data = *transfer->m_data;
+    data.curl = static_cast<CURL*>(curl);
+    data.toString = toString;
+    data.startTime = SteadyTime();
 
-    // Check for errors
-    if (res == CURLE_OK)
+    // the connections belong to the multi handle, which keeps them for the next transfers to the same server
+    if (m_idleTimeout <= 0)
     {
-        LOGSTR(Information) << "email sent successfully to " << toString;
+        curl_easy_setopt(curl, CURLOPT_FORBID_REUSE, 1L);
     }
     else
     {
-        LOGSTR(Error) << "curl_easy_perform() failed with " << res << " while sending to " << toString << " (" << curl_easy_strerror(res)
-                      << ")";
+        curl_easy_setopt(curl, CURLOPT_MAXAGE_CONN, (long)max(m_idleTimeout / 1000, 1));
     }
 
-    // Free the lists
-    curl_slist_free_all(recipients);
-    curl_slist_free_all(headers);
-    curl_mime_free(mime);
-
-    // curl does not send the QUIT command until you call cleanup, so you
-    // should be able to reuse this connection for additional messages
-    // (setting CURLOPT_MAIL_FROM and CURLOPT_MAIL_RCPT as required, and
-    // calling curl_easy_perform() again. It may not be a good idea to keep
-    // the connection open for a long time though (more than a few minutes may
-    // result in the server timing out the connection), and you do want to
-    // clean up in the end.
+    SetupTransfer(*transfer, subject, bodyParts, toAddresses, fromAddress.empty() ? m_defaultSourceAddress : fromAddress, timeout,
+                  attachments);
+    return transfer;
+}
 
-    curl_easy_cleanup(curl);
+int EmailSender::FinishTransfer(EmailTransfer& transfer, int result, bool& retry) const
+{
+    auto& data = *transfer.m_data;
+
+    // 0 means that the message went over an already open connection (or that the connection attempt failed)
+    long newConnections = 0;
+    curl_easy_getinfo(data.curl, CURLINFO_NUM_CONNECTS, &newConnections);
+
+    // Only a connection which the server has closed in the meantime deserves another attempt: it fails to send the first
+    // command or gets no reply at all, before any of the email is uploaded. After anything else (a rejected address, a
+    // timeout, a failure in the middle of the data), another attempt would fail again or even deliver the email twice.
+    curl_off_t uploaded = 0;
+    curl_easy_getinfo(data.curl, CURLINFO_SIZE_UPLOAD_T, &uploaded);
+    const bool closedByServer = (result == CURLE_SEND_ERROR || result == CURLE_GOT_NOTHING) && uploaded == 0;
+    retry = closedByServer && newConnections == 0 && !data.retried;
+    if (retry)
+    {
+        // the existing connection failed, most likely because the server closed it - reconnect and retry once
+        LOGSTR(Warning) << "delivery over the existing connection failed with " << result << " ("
+                        << curl_easy_strerror((CURLcode)result) << "), reconnecting";
+        data.retried = true;
+        curl_easy_setopt(data.curl, CURLOPT_FRESH_CONNECT, 1L);
+        return result;
+    }
 
-    return res;
+    LogResult(result, data.toString, data.startTime, newConnections);
+    return result;
 }
@@ -0,0 +1,522 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#include <Email/EmailSpool.h>
+#include <Logger/Logger.h>
+
+#include <array>
+#include <cstring>
+#include <fstream>
+
+using namespace std;
+
+namespace
+{
+// Spool file layout: magic, version, payload length and CRC-32 of the payload (all 32-bit, native byte order), followed by
+// the payload: owner, subject, recipient count, recipients, body, attachment count and attachments (file name, content type
+// and data). Strings are stored as a 32-bit length and the bytes.
+constexpr char spoolMagic[4] = {'S', 'W', 'D', 'S'};
+constexpr uint32_t spoolVersion = 2;
+constexpr size_t spoolHeaderSize = 16;
+constexpr const char* spoolExtension = ".spl";
+
+constexpr array<uint32_t, 256> MakeCrc32Table()
+{
+    array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+        {
+            c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+        }
+        table[i] = c;
+    }
+    return table;
+}
+
+uint32_t Crc32(const string& data)
+{
+    static constexpr auto table = MakeCrc32Table();
+    uint32_t crc = 0xFFFFFFFF;
+    for (const char c : data)
+    {
+        crc = table[(crc ^ static_cast<uint8_t>(c)) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+void AppendUInt32(string& buffer, uint32_t value) { buffer.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+
+void AppendString(string& buffer, const string& value)
+{
+    AppendUInt32(buffer, TOUINT32(value.length()));
+    buffer += value;
+}
+
+bool ReadUInt32(const string& buffer, size_t& position, uint32_t& value)
+{
+    if (buffer.length() - position < sizeof(value))
+    {
+        return false;
+    }
+    memcpy(&value, buffer.data() + position, sizeof(value));
+    position += sizeof(value);
+    return true;
+}
+
+bool ReadString(const string& buffer, size_t& position, string& value)
+{
+    uint32_t length = 0;
+    if (!ReadUInt32(buffer, position, length) || buffer.length() - position < length)
+    {
+        return false;
+    }
+    value.assign(buffer, position, length);
+    position += length;
+    return true;
+}
+}  // namespace
+
+EmailSpool::EmailSpool(const filesystem::path& directory, uint64_t maxSize, int retryDelay, int maxRetryDelay, uint64_t maxAge)
+    : m_directory(directory),
+      m_maxSize(maxSize),
+      m_retryDelay(max(retryDelay, 1)),
+      m_maxRetryDelay(max(maxRetryDelay, retryDelay)),
+      m_maxAge(maxAge),
+      m_size(0),
+      m_nextSequence(1),
+      m_nextExpiryTime(UINT64_MAX),
+      m_random(random_device{}())
+{
+    error_code ec;
+    filesystem::create_directories(m_directory, ec);
+
+    // index the emails left over from the previous runs; we only need the owner, the rest is verified on delivery
+    const uint64_t now = SteadyTime();
+    for (const auto& item : filesystem::directory_iterator(m_directory, ec))
+    {
+        const auto& path = item.path();
+        if (!item.is_regular_file(ec))
+        {
+            continue;
+        }
+        if (path.extension() == ".tmp")
+        {
+            // interrupted while writing
+            filesystem::remove(path, ec);
+            continue;
+        }
+        if (path.extension() != spoolExtension)
+        {
+            continue;
+        }
+
+        const uint64_t sequence = strtoull(path.stem().string().c_str(), nullptr, 16);
+        const uint64_t size = item.file_size(ec);
+        string header(spoolHeaderSize + sizeof(uint32_t) + 1024, '\0');
+        ifstream file(path, ios::binary);
+        file.read(header.data(), static_cast<streamsize>(header.size()));
+        header.resize(TOSIZE(file.gcount()));
+
+        uint32_t version = 0;
+        uint32_t length = 0;
+        size_t position = sizeof(spoolMagic);
+        size_t ownerPosition = spoolHeaderSize;
+        string owner;
+        if (sequence == 0 || header.compare(0, sizeof(spoolMagic), spoolMagic, sizeof(spoolMagic)) != 0 ||
+            !ReadUInt32(header, position, version) || version != spoolVersion || !ReadUInt32(header, position, length) ||
+            spoolHeaderSize + length != size || !ReadString(header, ownerPosition, owner))
+        {
+            LOGSTR(Error) << "removing damaged spool file " << path.string();
+            file.close();
+            filesystem::remove(path, ec);
+            continue;
+        }
+
+        // the file is written once, so its modification time tells how long the email has been waiting
+        const auto modified = item.last_write_time(ec);
+        const auto age = chrono::duration_cast<chrono::milliseconds>(filesystem::file_time_type::clock::now() - modified).count();
+        const uint64_t expiryTime = GetExpiryTime(ec ? 0 : TOUINT64(max<int64_t>(age, 0)));
+        m_entries[sequence] = {owner, size, 0, now, expiryTime, false};
+        m_nextExpiryTime = min(m_nextExpiryTime, expiryTime);
+        m_size += size;
+        m_nextSequence = max(m_nextSequence, sequence + 1);
+    }
+    if (ec)
+    {
+        LOGSTR(Error) << "failed to access spool directory " << m_directory.string() << ": " << ec.message();
+    }
+
+    LOGSTR() << "directory=" << m_directory.string() << ", maxSize=" << m_maxSize << ", retryDelay=" << m_retryDelay
+             << ", maxRetryDelay=" << m_maxRetryDelay << ", maxAge=" << m_maxAge << ", spooled emails=" << m_entries.size()
+             << ", size=" << m_size;
+}
+
+filesystem::path EmailSpool::GetFilePath(uint64_t sequence) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(sequence));
+    return m_directory / (string(name) + spoolExtension);
+}
+
+uint64_t EmailSpool::GetNextAttemptTime(int attempts)
+{
+    if (attempts <= 0)
+    {
+        return SteadyTime();
+    }
+
+    // exponential backoff with "equal jitter": half of the delay is fixed, the other half random, which spreads the retries
+    // of the emails that failed together
+    const uint64_t delay = min<uint64_t>(static_cast<uint64_t>(m_retryDelay) << min(attempts - 1, 30), m_maxRetryDelay);
+    return SteadyTime() + delay / 2 + uniform_int_distribution<uint64_t>(0, delay / 2)(m_random);
+}
+
+uint64_t EmailSpool::GetExpiryTime(uint64_t age) const
+{
+    return m_maxAge == 0 ? UINT64_MAX : SteadyTime() + (age < m_maxAge ? m_maxAge - age : 0);
+}
+
+void EmailSpool::RemoveEntry(map<uint64_t, Entry>::iterator it)
+{
+    error_code ec;
+    filesystem::remove(GetFilePath(it->first), ec);
+    m_size -= it->second.size;
+    m_entries.erase(it);
+}
+
+bool EmailSpool::Store(const string& owner, const string& subject, const vector<string>& recipients,
+                       const vector<shared_ptr<const IEmailBody>>& bodyParts, const vector<EmailAttachment>& attachments, int attempts)
+{
+    string payload;
+    AppendString(payload, owner);
+    AppendString(payload, subject);
+    AppendUInt32(payload, TOUINT32(recipients.size()));
+    for (const auto& recipient : recipients)
+    {
+        AppendString(payload, recipient);
+    }
+    // the body is rendered piece by piece, its length is filled in afterwards
+    const size_t bodyPosition = payload.length();
+    AppendUInt32(payload, 0);
+    string scratch;
+    for (const auto& part : bodyParts)
+    {
+        for (size_t i = 0; i < part->GetPieceCount(); i++)
+        {
+            payload += part->GetPiece(i, scratch);
+        }
+    }
+    const uint32_t bodyLength = TOUINT32(payload.length() - bodyPosition - sizeof(uint32_t));
+    memcpy(payload.data() + bodyPosition, &bodyLength, sizeof(bodyLength));
+    AppendUInt32(payload, TOUINT32(attachments.size()));
+    for (const auto& attachment : attachments)
+    {
+        AppendString(payload, attachment.fileName);
+        AppendString(payload, attachment.contentType);
+        AppendString(payload, attachment.data);
+    }
+
+    const uint64_t size = spoolHeaderSize + payload.length();
+    if (size > m_maxSize)
+    {
+        LOGSTR(Error) << "the email for " << owner << " is too large for the spool (" << size << " bytes), dropping it";
+        return false;
+    }
+
+    // reserve the sequence number and the space while holding the lock, but write the file without it, so the delivery
+    // threads asking for the next email don't wait for the disk
+    uint64_t sequence = 0;
+    size_t discarded = 0;
+    {
+        const lock_guard<mutex> lock(m_cs);
+
+        // make room by discarding the oldest emails (except the ones being delivered right now)
+        for (auto it = m_entries.begin(); m_size + size > m_maxSize && it != m_entries.end();)
+        {
+            if (it->second.busy)
+            {
+                ++it;
+                continue;
+            }
+            RemoveEntry(it++);
+            discarded++;
+        }
+        if (m_size + size <= m_maxSize)
+        {
+            sequence = m_nextSequence++;
+            m_size += size;
+        }
+    }
+    if (discarded > 0)
+    {
+        LOGSTR(Error) << "spool is full, discarded " << discarded << " oldest emails";
+    }
+    if (sequence == 0)
+    {
+        LOGSTR(Error) << "spool is full, dropping the email for " << owner;
+        return false;
+    }
+
+    // write to a temporary file first and rename it, so a crash never leaves a partially written email behind
+    const auto path = GetFilePath(sequence);
+    auto tmpPath = path;
+    tmpPath.replace_extension(".tmp");
+
+    string header(spoolMagic, sizeof(spoolMagic));
+    AppendUInt32(header, spoolVersion);
+    AppendUInt32(header, TOUINT32(payload.length()));
+    AppendUInt32(header, Crc32(payload));
+    bool stored = false;
+    {
+        ofstream file(tmpPath, ios::binary | ios::trunc);
+        file.write(header.data(), static_cast<streamsize>(header.length()));
+        file.write(payload.data(), static_cast<streamsize>(payload.length()));
+        file.close();
+        error_code ec;
+        if (!file)
+        {
+            LOGSTR(Error) << "failed to write spool file " << tmpPath.string() << ", dropping the email for " << owner;
+        }
+        else
+        {
+            filesystem::rename(tmpPath, path, ec);
+            if (ec)
+            {
+                LOGSTR(Error) << "failed to rename spool file " << tmpPath.string() << ": " << ec.message();
+            }
+            stored = !ec;
+        }
+        if (!stored)
+        {
+            filesystem::remove(tmpPath, ec);
+        }
+    }
+
+    const lock_guard<mutex> lock(m_cs);
+    if (!stored)
+    {
+        // give the reserved space back
+        m_size -= size;
+        return false;
+    }
+    const uint64_t expiryTime = GetExpiryTime(0);
+    m_entries[sequence] = {owner, size, attempts, GetNextAttemptTime(attempts), expiryTime, false};
+    m_nextExpiryTime = min(m_nextExpiryTime, expiryTime);
+    return true;
+}
+
+uint64_t EmailSpool::TakeDue(const function<bool(const string&)>& isOwnerAvailable, string& owner)
+{
+    const lock_guard<mutex> lock(m_cs);
+    const uint64_t now = SteadyTime();
+
+    // only the oldest email of each owner is a candidate, to keep them in order
+    vector<string> skipped;
+    for (auto& [sequence, entry] : m_entries)
+    {
+        if (entry.busy || ranges::find(skipped, entry.owner) != skipped.end())
+        {
+            continue;
+        }
+        if (entry.nextAttemptTime > now || !isOwnerAvailable(entry.owner))
+        {
+            skipped.push_back(entry.owner);
+            continue;
+        }
+
+        entry.busy = true;
+        owner = entry.owner;
+        return sequence;
+    }
+
+    return 0;
+}
+
+uint64_t EmailSpool::GetNextAttemptTime(const function<bool(const string&)>& isOwnerAvailable)
+{
+    const lock_guard<mutex> lock(m_cs);
+
+    uint64_t next = UINT64_MAX;
+    vector<string> seen;
+    for (const auto& [sequence, entry] : m_entries)
+    {
+        if (ranges::find(seen, entry.owner) != seen.end())
+        {
+            continue;
+        }
+        seen.push_back(entry.owner);
+        if (!entry.busy && isOwnerAvailable(entry.owner))
+        {
+            next = min(next, entry.nextAttemptTime);
+        }
+    }
+
+    return next;
+}
+
+bool EmailSpool::Load(uint64_t sequence, string& subject, vector<string>& recipients, string& body, vector<EmailAttachment>& attachments)
+{
+    // the entry is busy, so nobody else touches the file
+    const auto path = GetFilePath(sequence);
+    string data;
+    {
+        ifstream file(path, ios::binary | ios::ate);
+        if (file)
+        {
+            data.resize(TOSIZE(file.tellg()));
+            file.seekg(0);
+            file.read(data.data(), static_cast<streamsize>(data.size()));
+            data.resize(TOSIZE(file.gcount()));
+        }
+    }
+
+    uint32_t version = 0;
+    uint32_t length = 0;
+    uint32_t crc = 0;
+    uint32_t count = 0;
+    size_t position = sizeof(spoolMagic);
+    string owner;
+    bool valid = data.length() >= spoolHeaderSize && data.compare(0, sizeof(spoolMagic), spoolMagic, sizeof(spoolMagic)) == 0 &&
+                 ReadUInt32(data, position, version) && version == spoolVersion && ReadUInt32(data, position, length) &&
+                 ReadUInt32(data, position, crc) && spoolHeaderSize + length == data.length();
+    if (valid)
+    {
+        const string payload = data.substr(spoolHeaderSize);
+        position = 0;
+        valid = Crc32(payload) == crc && ReadString(payload, position, owner) && ReadString(payload, position, subject) &&
+                ReadUInt32(payload, position, count);
+        recipients.clear();
+        for (uint32_t i = 0; valid && i < count; i++)
+        {
+            valid = ReadString(payload, position, recipients.emplace_back());
+        }
+        valid = valid && ReadString(payload, position, body) && ReadUInt32(payload, position, count);
+        attachments.clear();
+        for (uint32_t i = 0; valid && i < count; i++)
+        {
+            auto& attachment = attachments.emplace_back();
+            valid = ReadString(payload, position, attachment.fileName) && ReadString(payload, position, attachment.contentType) &&
+                    ReadString(payload, position, attachment.data);
+        }
+        valid = valid && position == payload.length();
+    }
+
+    if (!valid)
+    {
+        LOGSTR(Error) << "removing damaged spool file " << path.string();
+        Remove(sequence);
+    }
+    return valid;
+}
+
+void EmailSpool::Remove(uint64_t sequence)
+{
+    const lock_guard<mutex> lock(m_cs);
+    const auto it = m_entries.find(sequence);
+    if (it != m_entries.end())
+    {
+        RemoveEntry(it);
+    }
+}
+
+void EmailSpool::Reschedule(uint64_t sequence)
+{
+    const lock_guard<mutex> lock(m_cs);
+    const auto it = m_entries.find(sequence);
+    if (it != m_entries.end())
+    {
+        it->second.busy = false;
+        it->second.attempts++;
+        it->second.nextAttemptTime = GetNextAttemptTime(it->second.attempts);
+        LOGSTR(Warning) << "delivery attempt " << it->second.attempts << " for " << it->second.owner << " failed, next one in "
+                        << (it->second.nextAttemptTime - SteadyTime()) << " ms";
+    }
+}
+
+void EmailSpool::Release(uint64_t sequence)
+{
+    const lock_guard<mutex> lock(m_cs);
+    const auto it = m_entries.find(sequence);
+    if (it != m_entries.end())
+    {
+        it->second.busy = false;
+    }
+}
+
+size_t EmailSpool::Expire()
+{
+    const lock_guard<mutex> lock(m_cs);
+    const uint64_t now = SteadyTime();
+    if (now < m_nextExpiryTime)
+    {
+        return 0;
+    }
+
+    size_t expired = 0;
+    m_nextExpiryTime = UINT64_MAX;
+    for (auto it = m_entries.begin(); it != m_entries.end();)
+    {
+        if (it->second.expiryTime <= now && !it->second.busy)
+        {
+            LOGSTR(Warning) << "discarding the email for " << it->second.owner << ", which has been in the spool for longer than "
+                            << m_maxAge << " ms";
+            RemoveEntry(it++);
+            expired++;
+            continue;
+        }
+        // an expired email, which is busy right now, is discarded by one of the next calls
+        m_nextExpiryTime = min(m_nextExpiryTime, max(it->second.expiryTime, now + 1));
+        ++it;
+    }
+    return expired;
+}
+
+map<string, size_t> EmailSpool::GetOwners()
+{
+    const lock_guard<mutex> lock(m_cs);
+    map<string, size_t> owners;
+    for (const auto& [sequence, entry] : m_entries)
+    {
+        owners[entry.owner]++;
+    }
+    return owners;
+}
+
+size_t EmailSpool::GetCount()
+{
+    const lock_guard<mutex> lock(m_cs);
+    return m_entries.size();
+}
+
+uint64_t EmailSpool::GetSize()
+{
+    const lock_guard<mutex> lock(m_cs);
+    return m_size;
+}
@@ -26,160 +26,1502 @@
  * Official repository: https://github.com/matjazt/SvcWatchDog
  */
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
 #include <iostream>
 #include <filesystem>
 #include <string>
 #include <sstream>
 
-#include <cinttypes>
+#include <cinttypes>
+#include <charconv>
+#include <limits>
+#include <utility>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+
+#include <JsonConfig/JsonConfig.h>
+#include <Logger/Logger.h>
+
+// a change must be followed by this many milliseconds of silence before the file is reloaded, because editors often save in several
+// steps (truncate, write, rename...)
+#define CONFIG_RELOAD_DELAY 300
+
+#define CONFIG_INCLUDE_KEY "$include"
+
+// increase it whenever the contents of the cache change
+#define CONFIG_CACHE_VERSION 1
+
+using namespace std;
+
+JsonConfig* JsonConfig::m_instance = nullptr;
+
+JsonConfig::JsonConfig() noexcept
+    : m_snapshot(make_shared<const Snapshot>()),
+      m_generation(0),
+      m_watching(false),
+      m_lastSubscriptionId(0)
+{
+}
+
+JsonConfig::~JsonConfig() { StopWatching(); }
+
+JsonConfig* JsonConfig::GetInstance() noexcept { return m_instance; }
+void JsonConfig::SetInstance(JsonConfig* instance) noexcept { m_instance = instance; }
+
+namespace
+{
+
+// Reads the whole file in binary mode, so it hashes the same as its mapped view.
+bool ReadFile(const filesystem::path& filePath, string& text)
+{
+    ifstream file(filePath, ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    text.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    return !file.bad();
+}
+
+// Used while the files are being watched, so it reads them instead of mapping them (see LoadFile()).
+size_t GetFileHash(const filesystem::path& filePath)
+{
+    string text;
+    return filesystem::is_regular_file(filePath) && ReadFile(filePath, text) ? hash<string_view>{}(text) : 0;
+}
+
+// Used on the initial load only, like the mapping in LoadFile().
+size_t GetMappedFileHash(const filesystem::path& filePath)
+{
+    MemoryMappedFile file;
+    return filesystem::is_regular_file(filePath) && file.Open(filePath) ? hash<string_view>{}(file.GetView()) : 0;
+}
+
+// Returns the size and the last write time of the file, zeros if it doesn't exist.
+pair<uintmax_t, int64_t> GetFileState(const filesystem::path& filePath)
+{
+    error_code ec;
+    const uintmax_t size = filesystem::file_size(filePath, ec);
+    if (ec)
+    {
+        return {0, 0};
+    }
+    const auto time = filesystem::last_write_time(filePath, ec);
+    return {size, ec ? 0 : TOINT64(time.time_since_epoch().count())};
+}
+
+string GetVariable(const string& name)
+{
+    const char* value = getenv(name.c_str());
+    return value ? value : name == "HOSTNAME" ? GetHostname() : "";
+}
+
+// Replaces ${NAME} with the value of the environment variable NAME and records the used variables.
+string ExpandVariables(const string& text, map<string, string>& variables)
+{
+    string result;
+    size_t position = 0;
+    for (size_t start; (start = text.find("${", position)) != string::npos;)
+    {
+        const size_t end = text.find('}', start);
+        if (end == string::npos)
+        {
+            break;
+        }
+
+        result.append(text, position, start - position);
+        const string name = text.substr(start + 2, end - start - 2);
+        const string value = GetVariable(name);
+        result += value;
+        variables[name] = value;
+        position = end + 1;
+    }
+    result.append(text, position);
+    return result;
+}
+
+vector<pair<string, string>> GetEnvironmentVariables()
+{
+    vector<pair<string, string>> variables;
+    const auto add = [&](const char* entry)
+    {
+        // on Windows, some hidden variables (like "=C:") start with '='
+        const char* separator = *entry ? strchr(entry + 1, '=') : nullptr;
+        if (separator)
+        {
+            variables.emplace_back(string(entry, separator), string(separator + 1));
+        }
+    };
+
+#ifdef _WIN32
+    char* block = GetEnvironmentStringsA();
+    if (block)
+    {
+        for (const char* entry = block; *entry; entry += strlen(entry) + 1)
+        {
+            add(entry);
+        }
+        FreeEnvironmentStringsA(block);
+    }
+#else
+    for (char** entry = environ; *entry; entry++)
+    {
+        add(*entry);
+    }
+#endif
+
+    // the order of the environment block isn't defined, but the layers must always be applied in the same order
+    sort(variables.begin(), variables.end());
+    return variables;
+}
+
+// Forgets the sources of the value and everything below it.
+void ForgetSources(map<string, string>& sources, const string& path)
+{
+    sources.erase(path);
+    const string prefix = path + ".";
+    for (auto source = sources.lower_bound(prefix); source != sources.end() && source->first.starts_with(prefix);)
+    {
+        source = sources.erase(source);
+    }
+}
+
+// Merges the layer over the configuration: objects are merged key by key, null removes the key and any other value replaces the
+// previous one, taking over the sources of the replaced values.
+void MergeLayer(json& target, json& layer, const string& path, const string& source, map<string, string>& sources)
+{
+    for (auto& item : layer.items())
+    {
+        const string itemPath = path.empty() ? item.key() : path + "." + item.key();
+        const auto existing = target.find(item.key());
+        if (item.value().is_object() && existing != target.end() && existing->is_object())
+        {
+            MergeLayer(*existing, item.value(), itemPath, source, sources);
+            continue;
+        }
+
+        ForgetSources(sources, itemPath);
+        if (!item.value().is_null())
+        {
+            target[item.key()] = std::move(item.value());
+            sources[itemPath] = source;
+        }
+        else if (existing != target.end())
+        {
+            target.erase(existing);
+        }
+    }
+}
+
+}  // namespace
+
+void JsonConfig::Load(const filesystem::path& filePath, vector<string> sections)
+{
+    const lock_guard<mutex> lock(m_loadCs);
+
+    if (!filesystem::is_regular_file(filePath))
+    {
+        throw runtime_error("File does not exist or is not a valid file: " + filePath.string());
+    }
+
+    Layers layers = LoadLayers(filePath, sections, true);
+    Publish(std::move(layers.data), std::move(layers.sources));
+
+    m_filePath = filePath;
+    m_sections = std::move(sections);
+    m_files = std::move(layers.files);
+}
+
+bool JsonConfig::Reload()
+{
+    const lock_guard<mutex> lock(m_loadCs);
+
+    if (m_filePath.empty())
+    {
+        return false;
+    }
+
+    Layers layers;
+    try
+    {
+        // the files are only hashed first, so saving them without changes doesn't parse anything
+        if (all_of(m_files.begin(), m_files.end(), [](const FileState& file) { return GetFileHash(file.path) == file.hash; }))
+        {
+            return false;
+        }
+
+        // parse before publishing anything, so an invalid file leaves the current snapshot in place; the cache is bypassed, because
+        // it doesn't notice the changes, which keep the size and the time of a file, and the files are read instead of mapped
+        layers = LoadLayers(m_filePath, m_sections, false);
+    }
+    catch (const exception& e)
+    {
+        LOGSTR(Error) << "unable to reload " << m_filePath.string() << ", keeping the current configuration: " << e.what();
+        return false;
+    }
+
+    LOGSTR(Information) << "configuration reloaded from " << m_filePath.string();
+    m_files = std::move(layers.files);
+    Publish(std::move(layers.data), std::move(layers.sources));
+    return true;
+}
+
+JsonConfig::Layers JsonConfig::LoadLayers(const filesystem::path& filePath, const vector<string>& sections, bool initial) const
+{
+    // the includes must be parsed even if only some sections are loaded
+    vector<string> fileSections = sections;
+    if (!fileSections.empty())
+    {
+        fileSections.push_back(CONFIG_INCLUDE_KEY);
+    }
+
+    Layers layers;
+    if (!initial || sections.empty() || !LoadCache(filePath, fileSections, layers))
+    {
+        vector<filesystem::path> includeStack;
+        LoadFile(filePath, false, initial, fileSections, layers, includeStack);
+        if (!sections.empty())
+        {
+            SaveCache(fileSections, layers);
+        }
+    }
+
+    if (m_environmentPrefix.empty())
+    {
+        return layers;
+    }
+
+    for (const auto& [name, value] : GetEnvironmentVariables())
+    {
+        if (name.length() <= m_environmentPrefix.length() ||
+            !equal(m_environmentPrefix.begin(), m_environmentPrefix.end(), name.begin(),
+                   [](char a, char b) { return tolower(static_cast<unsigned char>(a)) == tolower(static_cast<unsigned char>(b)); }))
+        {
+            continue;
+        }
+
+        vector<string> tokens;
+        for (size_t position = m_environmentPrefix.length(), end; position != string::npos; position = end == string::npos ? end : end + 2)
+        {
+            end = name.find("__", position);
+            tokens.push_back(name.substr(position, end == string::npos ? string::npos : end - position));
+        }
+        if (any_of(tokens.begin(), tokens.end(), [](const string& token) { return token.empty(); }) ||
+            (!sections.empty() && find(sections.begin(), sections.end(), tokens.front()) == sections.end()))
+        {
+            continue;
+        }
+
+        json layer = json::parse(value, nullptr, false);
+        if (layer.is_discarded())
+        {
+            layer = value;
+        }
+        for (auto token = tokens.rbegin(); token != tokens.rend(); ++token)
+        {
+            json object = json::object();
+            object[*token] = std::move(layer);
+            layer = std::move(object);
+        }
+        MergeLayer(layers.data, layer, "", "environment variable " + name, layers.sources);
+    }
+
+    return layers;
+}
+
+void JsonConfig::LoadFile(const filesystem::path& filePath, bool optional, bool map, const vector<string>& sections, Layers& layers,
+                          vector<filesystem::path>& includeStack)
+{
+    const filesystem::path canonicalPath = filesystem::weakly_canonical(filePath);
+    if (find(includeStack.begin(), includeStack.end(), canonicalPath) != includeStack.end())
+    {
+        throw runtime_error("File includes itself: " + filePath.string());
+    }
+
+    json data;
+    {
+        // if the file changes while it's being read, it has a newer time than the recorded one, so the cache isn't used next time
+        const auto [size, time] = GetFileState(filePath);
+
+        // the initial load maps the file only while it's being parsed, so it doesn't stay locked; a reload reads it instead, because
+        // the file is being edited then, and an editor truncating it under a mapping would crash us (SIGBUS) or fail to save (Windows)
+        MemoryMappedFile file;
+        string text;
+        if (!filesystem::is_regular_file(filePath) || !(map ? file.Open(filePath) : ReadFile(filePath, text)))
+        {
+            if (optional)
+            {
+                // still watched, so it's loaded as soon as it's created
+                layers.files.push_back({filePath, 0, 0, 0});
+                return;
+            }
+            throw runtime_error("File does not exist or is not a valid file: " + filePath.string());
+        }
+
+        const string_view jsonText = map ? file.GetView() : string_view(text);
+        layers.files.push_back({filePath, hash<string_view>{}(jsonText), size, time});
+        try
+        {
+            data = Parse(jsonText, sections);
+        }
+        catch (const exception& e)
+        {
+            // the including file is known to the caller, the included one isn't
+            throw runtime_error(includeStack.empty() ? e.what() : filePath.string() + ": " + e.what());
+        }
+    }
+
+    if (!data.is_object())
+    {
+        throw runtime_error("The configuration must be a JSON object: " + filePath.string());
+    }
+
+    const auto include = data.find(CONFIG_INCLUDE_KEY);
+    if (include != data.end())
+    {
+        json includes = std::move(*include);
+        data.erase(include);
+        if (!includes.is_array())
+        {
+            includes = json::array({std::move(includes)});
+        }
+
+        includeStack.push_back(canonicalPath);
+        for (const auto& item : includes)
+        {
+            if (!item.is_string())
+            {
+                throw runtime_error(CONFIG_INCLUDE_KEY " must contain file paths: " + filePath.string());
+            }
+
+            string includePath = ExpandVariables(item.get<string>(), layers.variables);
+            const bool includeOptional = includePath.starts_with('?');
+            filesystem::path path(includeOptional ? includePath.substr(1) : includePath);
+            if (path.is_relative())
+            {
+                path = filePath.parent_path() / path;
+            }
+            LoadFile(path, includeOptional, map, sections, layers, includeStack);
+        }
+        includeStack.pop_back();
+    }
+
+    MergeLayer(layers.data, data, "", filePath.string(), layers.sources);
+}
+
+bool JsonConfig::LoadCache(const filesystem::path& filePath, const vector<string>& sections, Layers& layers) const
+{
+    if (m_cacheFile.empty() || !filesystem::is_regular_file(m_cacheFile))
+    {
+        return false;
+    }
+
+    try
+    {
+        json cache;
+        {
+            MemoryMappedFile file;
+            if (!file.Open(m_cacheFile))
+            {
+                return false;
+            }
+            const string_view view = file.GetView();
+            cache = json::from_cbor(view.begin(), view.end());
+        }
+
+        if (cache.at("version") != CONFIG_CACHE_VERSION || cache.at("sections") != sections)
+        {
+            return false;
+        }
+
+        // the sizes and the times are compared first, because it's cheap
+        FileList files;
+        for (const auto& item : cache.at("files"))
+        {
+            FileState file{item.at(0).get<string>(), item.at(1).get<size_t>(), item.at(2).get<uintmax_t>(), item.at(3).get<int64_t>()};
+            if (GetFileState(file.path) != make_pair(file.size, file.time))
+            {
+                return false;
+            }
+            files.push_back(std::move(file));
+        }
+        if (files.empty() || files.front().path != filePath)
+        {
+            return false;
+        }
+
+        // the variables may have changed the include paths
+        for (const auto& item : cache.at("variables").items())
+        {
+            if (GetVariable(item.key()) != item.value())
+            {
+                return false;
+            }
+        }
+
+        // a change may keep both the size and the time (coarse timestamps, tools which restore them), so the contents are hashed as
+        // well; it's still much faster than parsing them
+        if (any_of(files.begin(), files.end(), [](const FileState& file) { return GetMappedFileHash(file.path) != file.hash; }))
+        {
+            return false;
+        }
+
+        layers.data = std::move(cache.at("data"));
+        layers.sources = cache.at("sources").get<SourceMap>();
+        layers.files = std::move(files);
+        layers.variables = cache.at("variables").get<map<string, string>>();
+        return true;
+    }
+    catch (const exception& e)
+    {
+        LOGSTR(Warning) << "ignoring the invalid configuration cache " << m_cacheFile.string() << ": " << e.what();
+        return false;
+    }
+}
+
+void JsonConfig::SaveCache(const vector<string>& sections, const Layers& layers) const
+{
+    if (m_cacheFile.empty())
+    {
+        return;
+    }
+
+    json files = json::array();
+    for (const auto& file : layers.files)
+    {
+        files.push_back({file.path.string(), file.hash, file.size, file.time});
+    }
+
+    // a CBOR map, encoded piece by piece, so the (possibly large) configuration isn't copied into a single document first
+    vector<uint8_t> cache = {0xA6};  // map of 6 pairs
+    const auto append = [&cache](const char* key, const json& value)
+    {
+        json::to_cbor(json(key), cache);
+        json::to_cbor(value, cache);
+    };
+    append("version", CONFIG_CACHE_VERSION);
+    append("sections", sections);
+    append("files", files);
+    append("variables", layers.variables);
+    append("sources", layers.sources);
+    append("data", layers.data);
+
+    // write to a temporary file first and rename it, so a crash never leaves a partially written cache behind
+    filesystem::path tmpPath = m_cacheFile;
+    tmpPath += ".tmp";
+    {
+        ofstream file(tmpPath, ios::binary | ios::trunc);
+        file.write(reinterpret_cast<const char*>(cache.data()), static_cast<streamsize>(cache.size()));
+        file.close();
+        if (!file)
+        {
+            LOGSTR(Warning) << "failed to write the configuration cache " << tmpPath.string();
+            error_code ec;
+            filesystem::remove(tmpPath, ec);
+            return;
+        }
+    }
+    error_code ec;
+    filesystem::rename(tmpPath, m_cacheFile, ec);
+    if (ec)
+    {
+        LOGSTR(Warning) << "failed to rename the configuration cache " << tmpPath.string() << ": " << ec.message();
+        filesystem::remove(tmpPath, ec);
+    }
+}
+
+void JsonConfig::SetJson(json data)
+{
+    const lock_guard<mutex> lock(m_loadCs);
+    Publish(std::move(data), {});
+}
+
+void JsonConfig::SetEnvironmentPrefix(string prefix)
+{
+    const lock_guard<mutex> lock(m_loadCs);
+    m_environmentPrefix = std::move(prefix);
+}
+
+void JsonConfig::SetCacheFile(filesystem::path cacheFile)
+{
+    const lock_guard<mutex> lock(m_loadCs);
+    m_cacheFile = std::move(cacheFile);
+}
+
+string JsonConfig::GetSource(const string& path, const string& key) const
+{
+    const auto snapshot = m_snapshot.load();
+    if (!FindKey(snapshot->data, path, key))
+    {
+        return "";
+    }
+
+    // only the replaced values are recorded, the others are found through their sections
+    string valuePath = path.empty() ? key : key.empty() ? path : path + "." + key;
+    while (!valuePath.empty())
+    {
+        const auto source = snapshot->sources.find(valuePath);
+        if (source != snapshot->sources.end())
+        {
+            return source->second;
+        }
+        const size_t dot = valuePath.rfind('.');
+        valuePath.erase(dot == string::npos ? 0 : dot);
+    }
+    return "";
+}
+
+void JsonConfig::Publish(json data, SourceMap sources)
+{
+    const auto oldSnapshot = m_snapshot.load();
+    const auto newSnapshot = make_shared<const Snapshot>(Snapshot{std::move(data), std::move(sources)});
+    m_snapshot.store(newSnapshot);
+    m_generation++;
+
+    // both snapshots stay alive until all the subscribers are done with them
+    for (auto& subscription : m_subscriptions)
+    {
+        const json* newValue = FindKey(newSnapshot->data, subscription.path);
+        const size_t newHash = GetHash(newValue);
+        if (newHash == subscription.hash)
+        {
+            continue;
+        }
+
+        subscription.hash = newHash;
+        try
+        {
+            subscription.callback(FindKey(oldSnapshot->data, subscription.path), newValue);
+        }
+        catch (const exception& e)
+        {
+            LOGSTR(Error) << "unable to apply the changes of section " << subscription.path.ToString() << ": " << e.what();
+        }
+    }
+}
+
+size_t JsonConfig::Subscribe(const string& section, SectionCallback callback, bool notifyNow)
+{
+    const lock_guard<mutex> lock(m_loadCs);
+
+    const auto snapshot = m_snapshot.load();
+    Subscription subscription{++m_lastSubscriptionId, ConfigPath(section), 0, std::move(callback)};
+    const json* value = FindKey(snapshot->data, subscription.path);
+    subscription.hash = GetHash(value);
+    if (notifyNow)
+    {
+        subscription.callback(nullptr, value);
+    }
+
+    m_subscriptions.push_back(std::move(subscription));
+    return m_lastSubscriptionId;
+}
+
+void JsonConfig::Unsubscribe(size_t id)
+{
+    const lock_guard<mutex> lock(m_loadCs);
+    erase_if(m_subscriptions, [id](const Subscription& subscription) { return subscription.id == id; });
+}
+
+size_t JsonConfig::GetHash(const json* value)
+{
+    // nlohmann's hash covers the structure as well as the values, so only the changed sections get a different hash
+    return value ? hash<json>{}(*value) : 0;
+}
+
+vector<string> JsonConfig::GetChangedKeys(const json* oldValue, const json* newValue, const vector<string>& ignoredKeys)
+{
+    static const json empty = json::object();
+    const json& oldObject = oldValue && oldValue->is_object() ? *oldValue : empty;
+    const json& newObject = newValue && newValue->is_object() ? *newValue : empty;
+
+    vector<string> keys;
+    const auto add = [&](const string& key)
+    {
+        if (key.find(' ') == string::npos && find(ignoredKeys.begin(), ignoredKeys.end(), key) == ignoredKeys.end())
+        {
+            keys.push_back(key);
+        }
+    };
+
+    for (const auto& item : newObject.items())
+    {
+        const auto oldItem = oldObject.find(item.key());
+        if (oldItem == oldObject.end() || *oldItem != item.value())
+        {
+            add(item.key());
+        }
+    }
+    for (const auto& item : oldObject.items())
+    {
+        if (!newObject.contains(item.key()))
+        {
+            add(item.key());
+        }
+    }
+    return keys;
+}
+
+shared_ptr<const json> JsonConfig::GetSnapshot() const noexcept
+{
+    // shares the ownership of the whole snapshot
+    auto snapshot = m_snapshot.load();
+    return shared_ptr<const json>(snapshot, &snapshot->data);
+}
+
+uint64_t JsonConfig::GetGeneration() const noexcept { return m_generation; }
+
+void JsonConfig::StartWatching()
+{
+    if (m_filePath.empty() || m_watching.exchange(true))
+    {
+        return;
+    }
+
+    m_watchThread = thread(&JsonConfig::WatchThread, this);
+}
+
+void JsonConfig::StopWatching()
+{
+    m_watching = false;
+    if (m_watchThread.joinable())
+    {
+        m_watchThread.join();
+    }
+}
+
+vector<filesystem::path> JsonConfig::GetFiles()
+{
+    const lock_guard<mutex> lock(m_loadCs);
+
+    vector<filesystem::path> files;
+    for (const auto& file : m_files)
+    {
+        files.push_back(file.path);
+    }
+    return files;
+}
+
+void JsonConfig::WatchThread()
+{
+    // the files are watched until a reload changes the includes, then the watches are set up again
+    while (m_watching)
+    {
+        WatchFiles(GetFiles());
+    }
+}
+
+void JsonConfig::WatchFiles(const vector<filesystem::path>& files)
+{
+    // watch the directories rather than the files themselves, because editors often replace the files instead of writing to them
+    vector<filesystem::path> directories;
+    for (const auto& file : files)
+    {
+        const filesystem::path directory = file.has_parent_path() ? file.parent_path() : filesystem::path(".");
+        if (find(directories.begin(), directories.end(), directory) == directories.end())
+        {
+            directories.push_back(directory);
+        }
+    }
+
+#ifdef _WIN32
+    vector<HANDLE> notifications;
+    for (const auto& directory : directories)
+    {
+        HANDLE notification = notifications.size() < MAXIMUM_WAIT_OBJECTS
+                                  ? FindFirstChangeNotificationW(directory.c_str(), FALSE,
+                                                                 FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE |
+                                                                     FILE_NOTIFY_CHANGE_LAST_WRITE)
+                                  : INVALID_HANDLE_VALUE;
+        if (notification == INVALID_HANDLE_VALUE)
+        {
+            LOGSTR(Error) << "unable to watch " << directory.string() << " for changes, error " << GetLastError();
+            continue;
+        }
+        notifications.push_back(notification);
+    }
+    const bool watching = !notifications.empty();
+
+    const auto closeNotifications = [&]()
+    {
+        for (HANDLE notification : notifications)
+        {
+            FindCloseChangeNotification(notification);
+        }
+    };
+
+    // Windows only tells us that something in a directory has changed, so we compare the file times and sizes ourselves
+    const auto getFileStates = [&files]()
+    {
+        vector<pair<filesystem::file_time_type, uintmax_t>> states;
+        for (const auto& file : files)
+        {
+            error_code ec;
+            const auto size = filesystem::file_size(file, ec);
+            states.emplace_back(filesystem::last_write_time(file, ec), size);
+        }
+        return states;
+    };
+    auto fileStates = getFileStates();
+
+    const auto waitForChange = [&]()
+    {
+        const DWORD result = WaitForMultipleObjects(static_cast<DWORD>(notifications.size()), notifications.data(), FALSE, 100);
+        if (result >= WAIT_OBJECT_0 + notifications.size())  // also WAIT_TIMEOUT and WAIT_FAILED
+        {
+            return false;
+        }
+        FindNextChangeNotification(notifications[result - WAIT_OBJECT_0]);
+
+        const auto newStates = getFileStates();
+        const bool changed = newStates != fileStates;
+        fileStates = newStates;
+        return changed;
+    };
+#else
+    const int notification = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    bool watching = false;
+    for (const auto& directory : directories)
+    {
+        if (notification < 0 || inotify_add_watch(notification, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+        {
+            LOGSTR(Error) << "unable to watch " << directory.string() << " for changes, error " << errno;
+            continue;
+        }
+        watching = true;
+    }
+
+    const auto closeNotifications = [&]()
+    {
+        if (notification >= 0)
+        {
+            close(notification);
+        }
+    };
+
+    vector<string> fileNames;
+    for (const auto& file : files)
+    {
+        fileNames.push_back(file.filename().string());
+    }
+
+    const auto waitForChange = [&]()
+    {
+        pollfd pfd = {notification, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0)
+        {
+            return false;
+        }
+
+        // the events of all the files in the directories are read, but only the ones of our files count (files with the same name
+        // in another watched directory cause an unnecessary check, which is harmless)
+        bool changed = false;
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = read(notification, buffer, sizeof(buffer))) > 0)
+        {
+            for (ssize_t offset = 0; offset < length;)
+            {
+                const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                if (event->len > 0 && find(fileNames.begin(), fileNames.end(), event->name) != fileNames.end())
+                {
+                    changed = true;
+                }
+                offset += TOINT64(sizeof(inotify_event) + event->len);
+            }
+        }
+        return changed;
+    };
+#endif
+
+    if (!watching)
+    {
+        closeNotifications();
+        m_watching = false;
+        return;
+    }
+
+    for (const auto& file : files)
+    {
+        LOGSTR() << "watching " << file.string() << " for changes";
+    }
+
+    uint64_t changeTime = 0;  // time of the last change, which hasn't been reloaded yet
+    while (m_watching)
+    {
+        if (waitForChange())
+        {
+            changeTime = SteadyTime();
+        }
+        else if (changeTime != 0 && SteadyTime() - changeTime >= CONFIG_RELOAD_DELAY)
+        {
+            changeTime = 0;
+            if (Reload() && GetFiles() != files)
+            {
+                // the includes have changed
+                break;
+            }
+        }
+    }
+
+    closeNotifications();
+}
+
+namespace
+{
+// Returns the member with the given name, or nullptr if there is no such member or the value is not an object at all.
+// Unlike contains() followed by operator[], this only looks the name up once.
+const json* FindMember(const json* object, string_view name)
+{
+    if (!object->is_object())
+    {
+        return nullptr;
+    }
+    const auto it = object->find(name);
+    return it != object->end() ? &*it : nullptr;
+}
+
+struct UnitSuffix
+{
+    const char* name;
+    uint64_t multiplier;
+    uint64_t divisor;  // the value must be divisible by it
+};
+
+const UnitSuffix byteSuffixes[] = {{"B", 1, 1},
+                                   {"KB", 1024ULL, 1},
+                                   {"MB", 1024ULL * 1024, 1},
+                                   {"GB", 1024ULL * 1024 * 1024, 1},
+                                   {"TB", 1024ULL * 1024 * 1024 * 1024, 1}};
+const UnitSuffix millisecondSuffixes[] = {
+    {"ms", 1, 1}, {"s", 1000, 1}, {"min", 60 * 1000, 1}, {"h", 3600 * 1000, 1}, {"d", 86400 * 1000, 1}};
+const UnitSuffix secondSuffixes[] = {{"ms", 1, 1000}, {"s", 1, 1}, {"min", 60, 1}, {"h", 3600, 1}, {"d", 86400, 1}};
+
+// Finds the unit suffix (case insensitive); an empty suffix is always allowed and means the base unit.
+bool FindUnitSuffix(string_view suffix, ConfigUnit unit, UnitSuffix& result)
+{
+    result = {"", 1, 1};
+    if (suffix.empty())
+    {
+        return true;
+    }
+
+    span<const UnitSuffix> suffixes;
+    switch (unit)
+    {
+        case ConfigUnit::Bytes:
+            suffixes = byteSuffixes;
+            break;
+        case ConfigUnit::Milliseconds:
+            suffixes = millisecondSuffixes;
+            break;
+        case ConfigUnit::Seconds:
+            suffixes = secondSuffixes;
+            break;
+        default:
+            return false;
+    }
+
+    for (const auto& candidate : suffixes)
+    {
+        if (suffix.length() == strlen(candidate.name) &&
+            equal(suffix.begin(), suffix.end(), candidate.name, [](char a, char b) { return tolower(TOUCHAR(a)) == tolower(TOUCHAR(b)); }))
+        {
+            result = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parses a number, written as a string, without allocating anything. See JsonConfig::TryParseNumber() for the supported formats.
+template <typename T>
+bool ParseNumberString(string_view text, ConfigUnit unit, T& value)
+{
+    const auto isSpace = [](char c) { return c == ' ' || c == '\t'; };
+    while (!text.empty() && isSpace(text.front()))
+    {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && isSpace(text.back()))
+    {
+        text.remove_suffix(1);
+    }
+
+    const bool negative = !text.empty() && text.front() == '-';
+    if (!text.empty() && (text.front() == '-' || text.front() == '+'))
+    {
+        text.remove_prefix(1);
+    }
+
+    int base = 10;
+    if (text.length() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+    {
+        base = 16;
+        text.remove_prefix(2);
+    }
+    else if (text.length() > 2 && text[0] == '0' && (text[1] == 'b' || text[1] == 'B'))
+    {
+        base = 2;
+        text.remove_prefix(2);
+    }
+
+    // copy the digits without the separators into a local buffer; floating point numbers may also have a fraction and an exponent
+    const auto isDigit = [base](char c)
+    { return base == 16 ? isxdigit(TOUCHAR(c)) != 0 : (base == 2 ? (c == '0' || c == '1') : isdigit(TOUCHAR(c)) != 0); };
+    char digits[80];
+    size_t length = 0;
+    size_t pos = 0;
+    for (; pos < text.length() && length < sizeof(digits); pos++)
+    {
+        const char c = text[pos];
+        if (isDigit(c))
+        {
+            digits[length++] = c;
+        }
+        else if ((c == '_' || c == '\'') && length > 0 && isDigit(digits[length - 1]) && pos + 1 < text.length() && isDigit(text[pos + 1]))
+        {
+            // digit separator, only allowed between two digits
+        }
+        else if (is_floating_point_v<T> && base == 10 && (c == '.' || ((c == 'e' || c == 'E') && length > 0 && pos + 1 < text.length() &&
+                                                                         (isdigit(TOUCHAR(text[pos + 1])) || text[pos + 1] == '-' ||
+                                                                          text[pos + 1] == '+'))))
+        {
+            digits[length++] = c;
+            if (c != '.')
+            {
+                // exponent sign
+                pos++;
+                if (length < sizeof(digits))
+                {
+                    digits[length++] = text[pos];
+                }
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
 
-#include <JsonConfig/JsonConfig.h>
+    string_view suffix = text.substr(pos);
+    while (!suffix.empty() && isSpace(suffix.front()))
+    {
+        suffix.remove_prefix(1);
+    }
 
-using namespace std;
+    UnitSuffix unitSuffix;
+    if (length == 0 || length == sizeof(digits) || !FindUnitSuffix(suffix, unit, unitSuffix))
+    {
+        return false;
+    }
 
-JsonConfig* JsonConfig::m_instance = nullptr;
+    if constexpr (is_floating_point_v<T>)
+    {
+        double number = 0;
+        if (base == 10)
+        {
+            const auto result = from_chars(digits, digits + length, number);
+            if (result.ec != errc() || result.ptr != digits + length)
+            {
+                return false;
+            }
+        }
+        else
+        {
+            uint64_t integer = 0;
+            const auto result = from_chars(digits, digits + length, integer, base);
+            if (result.ec != errc() || result.ptr != digits + length)
+            {
+                return false;
+            }
+            number = static_cast<double>(integer);
+        }
 
-JsonConfig::JsonConfig() noexcept = default;
+        number = number * static_cast<double>(unitSuffix.multiplier) / static_cast<double>(unitSuffix.divisor);
+        if (!isfinite(number) || fabs(number) > static_cast<double>(numeric_limits<T>::max()))
+        {
+            return false;
+        }
+        value = static_cast<T>(negative ? -number : number);
+        return true;
+    }
+    else
+    {
+        // parse the magnitude, apply the unit and then check whether it fits into T, including the sign
+        uint64_t magnitude = 0;
+        const auto result = from_chars(digits, digits + length, magnitude, base);
+        if (result.ec != errc() || result.ptr != digits + length || magnitude > UINT64_MAX / unitSuffix.multiplier ||
+            (magnitude * unitSuffix.multiplier) % unitSuffix.divisor != 0)
+        {
+            return false;
+        }
+        magnitude = magnitude * unitSuffix.multiplier / unitSuffix.divisor;
 
-JsonConfig::~JsonConfig() = default;
+        if (!negative)
+        {
+            if (magnitude > static_cast<uint64_t>(numeric_limits<T>::max()))
+            {
+                return false;
+            }
+            value = static_cast<T>(magnitude);
+            return true;
+        }
 
-JsonConfig* JsonConfig::GetInstance() noexcept { return m_instance; }
-void JsonConfig::SetInstance(JsonConfig* instance) noexcept { m_instance = instance; }
+        if constexpr (is_signed_v<T>)
+        {
+            // the magnitude of the minimum is one more than the maximum
+            if (magnitude > static_cast<uint64_t>(numeric_limits<T>::max()) + 1)
+            {
+                return false;
+            }
+            value = static_cast<T>(-static_cast<int64_t>(magnitude - 1) - 1);
+            return true;
+        }
+        else
+        {
+            // "-0" is the only negative value an unsigned type can hold
+            if (magnitude != 0)
+            {
+                return false;
+            }
+            value = 0;
+            return true;
+        }
+    }
+}
 
-void JsonConfig::Load(const filesystem::path& filePath)
+// Throws an exception, describing the syntax error at the given position of the text, with the line, the column and the offending
+// line (or the part of it around the error, if it's long), so the error can be found without printing the whole file.
+[[noreturn]] void ThrowSyntaxError(string_view text, size_t position, const string& message)
 {
-    const string jsonText = LoadTextFile(filePath);
-    try
+    position = min(position, text.length());
+    const size_t lineStart = position == 0 ? 0 : text.rfind('\n', position - 1) + 1;  // npos + 1 wraps around to 0
+    const size_t lineNumber = TOSIZE(count(text.begin(), text.begin() + TOINT64(lineStart), '\n')) + 1;
+    const size_t column = position - lineStart + 1;
+
+    const size_t excerptStart = column > 100 ? position - 60 : lineStart;
+    string_view excerpt = text.substr(excerptStart, 120);
+    excerpt = excerpt.substr(0, min(excerpt.find_first_of("\r\n"), excerpt.length()));
+    string marker(text.substr(excerptStart, position - excerptStart));
+    replace_if(marker.begin(), marker.end(), [](char c) { return c != '\t'; }, ' ');
+
+    throw runtime_error("invalid JSON at line " + to_string(lineNumber) + ", column " + to_string(column) + ": " + message + "\n" +
+                        string(excerpt) + "\n" + marker + "^");
+}
+
+// Same as above, for errors reported by the JSON parser, which parsed the text from the given offset on.
+[[noreturn]] void ThrowSyntaxError(string_view text, size_t offset, const json::parse_error& e)
+{
+    // drop nlohmann's own (less accurate) position from the message
+    string message = e.what();
+    const size_t messageStart = message.find(": ");
+    if (messageStart != string::npos)
     {
-        m_json = json::parse(jsonText);
+        message.erase(0, messageStart + 2);
     }
-    catch (...)
+
+    // e.byte is the 1-based position of the last character read
+    ThrowSyntaxError(text, offset + TOSIZE(e.byte > 0 ? e.byte - 1 : 0), message);
+}
+
+size_t SkipWhitespace(string_view text, size_t position)
+{
+    const size_t end = text.find_first_not_of(" \t\r\n", position);
+    return end == string_view::npos ? text.length() : end;
+}
+
+// Returns the position of the closing quote of the string, which starts at the given position.
+size_t SkipString(string_view text, size_t position)
+{
+    for (position++;; position += 2)
     {
-        // show the file contents
-        cerr << "JSON file\n:" << jsonText << "\n";
-        throw;
+        position = text.find_first_of("\"\\", position);
+        if (position == string_view::npos)
+        {
+            ThrowSyntaxError(text, text.length(), "unterminated string");
+        }
+        if (text[position] == '"')
+        {
+            return position;
+        }
     }
 }
 
-json* JsonConfig::GetJson(const string& path) { return path.empty() ? &m_json : FindKey(path, ""); }
+// Returns the position just after the value, which starts at the given position. Only the brackets (including their pairing) and
+// the strings are checked, which is enough to skip the value reliably, but not to validate it.
+size_t SkipValue(string_view text, size_t position)
+{
+    if (position < text.length() && text[position] != '"' && text[position] != '{' && text[position] != '[')
+    {
+        // a number or a literal
+        return min(text.find_first_of(",}] \t\r\n", position), text.length());
+    }
+
+    string closing;  // the closing brackets expected, the innermost one last
+    for (; position < text.length(); position++)
+    {
+        switch (text[position])
+        {
+            case '"':
+                position = SkipString(text, position);
+                if (closing.empty())
+                {
+                    return position + 1;
+                }
+                break;
+
+            case '{':
+                closing.push_back('}');
+                break;
 
-json* JsonConfig::FindKey(const string& path, const string& key)
+            case '[':
+                closing.push_back(']');
+                break;
+
+            case '}':
+            case ']':
+                if (text[position] != closing.back())
+                {
+                    ThrowSyntaxError(text, position, string("expected '") + closing.back() + "'");
+                }
+                closing.pop_back();
+                if (closing.empty())
+                {
+                    return position + 1;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    ThrowSyntaxError(text, text.length(), "unexpected end of input");
+}
+
+// Parses only the given top-level sections of the configuration. The other sections are skipped over without being parsed, so
+// their cost is little more than reading them.
+json ParseSections(string_view text, const vector<string>& sections)
 {
-    auto tokens = Split(path, '.');
-    if (!key.empty())
+    json root = json::object();
+
+    size_t position = SkipWhitespace(text, text.starts_with("\xEF\xBB\xBF") ? 3 : 0);
+    if (position >= text.length() || text[position] != '{')
     {
-        tokens.push_back(key);
+        ThrowSyntaxError(text, position, "expected '{'");
     }
 
-    json* current = &m_json;
-    for (const auto& token : tokens)
+    position = SkipWhitespace(text, position + 1);
+    bool more = position >= text.length() || text[position] != '}';  // unless the object is empty
+    while (more)
     {
-        if (current->contains(token))
+        if (position >= text.length() || text[position] != '"')
         {
-            current = &(*current)[token];
+            ThrowSyntaxError(text, position, "expected a section name");
         }
-        else
+        const size_t nameEnd = SkipString(text, position);
+        string name(text.substr(position + 1, nameEnd - position - 1));
+        if (name.find('\\') != string::npos)
+        {
+            name = json::parse(text.substr(position, nameEnd - position + 1)).get<string>();  // decode the escape sequences
+        }
+
+        position = SkipWhitespace(text, nameEnd + 1);
+        if (position >= text.length() || text[position] != ':')
+        {
+            ThrowSyntaxError(text, position, "expected ':'");
+        }
+
+        const size_t valueStart = SkipWhitespace(text, position + 1);
+        position = SkipValue(text, valueStart);
+        if (position == valueStart)
+        {
+            ThrowSyntaxError(text, position, "expected a value");
+        }
+
+        if (find(sections.begin(), sections.end(), name) != sections.end())
+        {
+            try
+            {
+                root[name] = json::parse(text.substr(valueStart, position - valueStart));
+            }
+            catch (const json::parse_error& e)
+            {
+                ThrowSyntaxError(text, valueStart, e);
+            }
+        }
+
+        position = SkipWhitespace(text, position);
+        if (position >= text.length() || (text[position] != ',' && text[position] != '}'))
+        {
+            ThrowSyntaxError(text, position, "expected ',' or '}'");
+        }
+
+        more = text[position] == ',';
+        if (more)
         {
-            return nullptr;
+            position = SkipWhitespace(text, position + 1);
         }
     }
 
-    return current;
+    if (SkipWhitespace(text, position + 1) != text.length())
+    {
+        ThrowSyntaxError(text, SkipWhitespace(text, position + 1), "unexpected text after the end of the configuration");
+    }
+    return root;
 }
+}  // namespace
 
-template <typename T>
-T JsonConfig::GetParameter(const string& path, const string& key, T defaultValue)
+json JsonConfig::Parse(string_view text, const vector<string>& sections)
 {
+    if (!sections.empty())
+    {
+        return ParseSections(text, sections);
+    }
+
     try
     {
-        const auto* parameter = FindKey(path, key);
-        return parameter ? parameter->get<T>() : std::move(defaultValue);
+        return json::parse(text);
     }
-    catch (...)
+    catch (const json::parse_error& e)
     {
-        return std::move(defaultValue);
+        ThrowSyntaxError(text, 0, e);
     }
 }
 
-string JsonConfig::GetString(const string& path, const string& key, const string& defaultValue)
+ConfigPath::ConfigPath(string_view path)
 {
-    return GetParameter(path, key, defaultValue);
+    if (!path.empty())
+    {
+        for (size_t start = 0;;)
+        {
+            const size_t end = path.find('.', start);
+            m_tokens.emplace_back(path.substr(start, end - start));
+            if (end == string_view::npos)
+            {
+                break;
+            }
+            start = end + 1;
+        }
+    }
 }
 
-int JsonConfig::GetString(const string& path, const string& key, char* buffer, size_t bufferSize, const string& defaultValue)
+ConfigPath::ConfigPath(const ConfigPath& section, string_view key) : m_tokens(section.m_tokens) { m_tokens.emplace_back(key); }
+
+string ConfigPath::ToString() const { return m_tokens.empty() ? "" : JoinStrings(m_tokens, "."); }
+
+shared_ptr<const json> JsonConfig::GetJson(const string& path)
 {
-    string v = GetParameter(path, key, defaultValue);
-    strncpy(buffer, &v[0], bufferSize - 1);
-    buffer[bufferSize - 1] = 0;
-    return TOINT(strlen(buffer));
+    auto snapshot = GetSnapshot();
+    const json* value = FindKey(*snapshot, path, "");
+    return value ? shared_ptr<const json>(std::move(snapshot), value) : nullptr;
 }
 
-template <typename T>
-T JsonConfig::GetNumber(const string& path, const string& key, T defaultValue)
+const json* JsonConfig::FindKey(const json& root, const string& path, const string& key)
+{
+    // walk the path token by token, without splitting it into a vector first
+    const json* current = &root;
+    for (size_t start = 0; current && !path.empty();)
+    {
+        const size_t end = path.find('.', start);
+        current = FindMember(current, string_view(path).substr(start, end - start));
+        if (end == string::npos)
+        {
+            break;
+        }
+        start = end + 1;
+    }
+
+    return (current && !key.empty()) ? FindMember(current, key) : current;
+}
+
+const json* JsonConfig::FindKey(const json& root, const ConfigPath& path)
 {
-    const auto* parameter = FindKey(path, key);
-    if (!parameter)
+    const json* current = &root;
+    for (const auto& token : path.GetTokens())
     {
-        // key not present, so we should stop trying immediately
-        return defaultValue;
+        current = FindMember(current, token);
+        if (!current)
+        {
+            break;
+        }
     }
 
+    return current;
+}
+
+template <typename T>
+T JsonConfig::GetParameter(const json* parameter, T defaultValue)
+{
     try
     {
-        // try to read it as a number
-        return parameter->get<T>();
+        return parameter ? parameter->get<T>() : std::move(defaultValue);
     }
     catch (...)
     {
+        return std::move(defaultValue);
     }
+}
 
-    // so the key is present, but it is not a number
-    try
+int JsonConfig::CopyString(const string& value, char* buffer, size_t bufferSize)
+{
+    strncpy(buffer, value.c_str(), bufferSize - 1);
+    buffer[bufferSize - 1] = 0;
+    return TOINT(strlen(buffer));
+}
+
+string JsonConfig::GetString(const string& path, const string& key, const string& defaultValue)
+{
+    return GetParameter(FindKey(*GetSnapshot(), path, key), defaultValue);
+}
+
+int JsonConfig::GetString(const string& path, const string& key, char* buffer, size_t bufferSize, const string& defaultValue)
+{
+    return CopyString(GetString(path, key, defaultValue), buffer, bufferSize);
+}
+
+template <typename T>
+T JsonConfig::GetNumber(const string& path, const string& key, T defaultValue, ConfigUnit unit)
+{
+    return ParseNumber(FindKey(*GetSnapshot(), path, key), defaultValue, unit);
+}
+
+template <typename T>
+T JsonConfig::ParseNumber(const json* parameter, T defaultValue, ConfigUnit unit)
+{
+    // if the key is not present, we should stop trying immediately
+    T value;
+    return (parameter && TryParseNumber(*parameter, value, unit)) ? value : defaultValue;
+}
+
+template <typename T>
+bool JsonConfig::TryParseNumber(const json& parameter, T& value, ConfigUnit unit)
+{
+    switch (parameter.type())
     {
-        const string s = parameter->get<string>();
-        if (s.starts_with("0x") || s.starts_with("0X"))
+        case json::value_t::number_unsigned:
         {
-            // we probably have a hex number
-            uint64_t hex = 0;
-            char unparsed = 0;
-            if (sscanf(s.c_str(), "%" PRIX64 " %c", &hex, &unparsed) == 1)
+            const uint64_t number = parameter.get<uint64_t>();
+            if constexpr (is_integral_v<T>)
             {
-                // we're deliberately ignoring the overflow check here (if (static_cast<uint64_t>(value) == hex))
-                return static_cast<T>(hex);
+                if (!in_range<T>(number))
+                {
+                    return false;
+                }
             }
+            value = static_cast<T>(number);
+            return true;
         }
-        else
+        case json::value_t::number_integer:
         {
-            // attempt to parse the string into the target numeric type
-            std::istringstream iss(s);
-            T value;
-            iss >> value;
-
-            // check for errors (e.g., invalid characters or partial parsing)
-            if (!iss.fail() && iss.eof())
+            const int64_t number = parameter.get<int64_t>();
+            if constexpr (is_integral_v<T>)
             {
-                return value;
+                if (!in_range<T>(number))
+                {
+                    return false;
+                }
             }
+            value = static_cast<T>(number);
+            return true;
         }
+        case json::value_t::number_float:
+        {
+            // fractions are truncated when the target is an integer; the maximum of a 64-bit integer isn't exact in double (it rounds
+            // up to 2^63 or 2^64, which doesn't fit), so integers are compared with the power of two above their maximum instead
+            const double number = parameter.get<double>();
+            bool fits = number >= static_cast<double>(numeric_limits<T>::lowest());  // false for NaN
+            if constexpr (is_integral_v<T>)
+            {
+                fits = fits && number < ldexp(1.0, numeric_limits<T>::digits);
+            }
+            else
+            {
+                fits = fits && number <= static_cast<double>(numeric_limits<T>::max());
+            }
+            if (!fits)
+            {
+                return false;
+            }
+            value = static_cast<T>(number);
+            return true;
+        }
+        case json::value_t::boolean:
+            value = static_cast<T>(parameter.get<bool>() ? 1 : 0);
+            return true;
+        case json::value_t::string:
+            return ParseNumberString(parameter.get_ref<const string&>(), unit, value);
+        default:
+            return false;
     }
-    catch (...)
-    {
-    }
-
-    return defaultValue;
 }
 
-bool JsonConfig::GetBool(const string& path, const string& key, bool defaultValue) { return GetParameter(path, key, defaultValue); }
+bool JsonConfig::GetBool(const string& path, const string& key, bool defaultValue)
+{
+    return GetParameter(FindKey(*GetSnapshot(), path, key), defaultValue);
+}
 
 vector<string> JsonConfig::GetStringVector(const string& path, const string& key, vector<string> defaultValue)
 {
-    return GetParameter(path, key, std::move(defaultValue));
+    return GetParameter(FindKey(*GetSnapshot(), path, key), std::move(defaultValue));
 }
 
 vector<string> JsonConfig::GetKeys(const string& path, bool includeObjects = true, bool includeArrays = true, bool includeOthers = true)
+{
+    return GetKeys(FindKey(*GetSnapshot(), path, ""), includeObjects, includeArrays, includeOthers);
+}
+
+shared_ptr<const json> JsonConfig::GetJson(const ConfigPath& path)
+{
+    auto snapshot = GetSnapshot();
+    const json* value = FindKey(*snapshot, path);
+    return value ? shared_ptr<const json>(std::move(snapshot), value) : nullptr;
+}
+
+string JsonConfig::GetString(const ConfigPath& path, const string& defaultValue)
+{
+    return GetParameter(FindKey(*GetSnapshot(), path), defaultValue);
+}
+
+int JsonConfig::GetString(const ConfigPath& path, char* buffer, size_t bufferSize, const string& defaultValue)
+{
+    return CopyString(GetString(path, defaultValue), buffer, bufferSize);
+}
+
+template <typename T>
+T JsonConfig::GetNumber(const ConfigPath& path, T defaultValue, ConfigUnit unit)
+{
+    return ParseNumber(FindKey(*GetSnapshot(), path), defaultValue, unit);
+}
+
+bool JsonConfig::GetBool(const ConfigPath& path, bool defaultValue) { return GetParameter(FindKey(*GetSnapshot(), path), defaultValue); }
+
+vector<string> JsonConfig::GetStringVector(const ConfigPath& path, vector<string> defaultValue)
+{
+    return GetParameter(FindKey(*GetSnapshot(), path), std::move(defaultValue));
+}
+
+vector<string> JsonConfig::GetKeys(const ConfigPath& path, bool includeObjects, bool includeArrays, bool includeOthers)
+{
+    return GetKeys(FindKey(*GetSnapshot(), path), includeObjects, includeArrays, includeOthers);
+}
+
+vector<string> JsonConfig::GetKeys(const json* section, bool includeObjects, bool includeArrays, bool includeOthers)
 {
     vector<string> keys;
-    auto* section = FindKey(path, "");
     if (section)
     {
         for (auto& item : section->items())
@@ -207,18 +1549,122 @@ vector<string> JsonConfig::GetKeys(const string& path, bool includeObjects = tru
     return keys;
 }
 
+ConfigView JsonConfig::GetView(const string& path)
+{
+    auto snapshot = GetSnapshot();
+    const json* value = FindKey(*snapshot, path, "");
+    return ConfigView(std::move(snapshot), value);
+}
+
+ConfigView JsonConfig::GetView(const ConfigPath& path)
+{
+    auto snapshot = GetSnapshot();
+    const json* value = FindKey(*snapshot, path);
+    return ConfigView(std::move(snapshot), value);
+}
+
+const json& ConfigKeyProjection::Empty()
+{
+    static const json empty = json::object();
+    return empty;
+}
+
+const json& ConfigStringProjection::Empty()
+{
+    static const json empty = json::array();
+    return empty;
+}
+
+const json* ConfigView::Find(string_view key) const { return m_value ? FindMember(m_value, key) : nullptr; }
+
+ConfigView ConfigView::GetView(string_view key) const { return ConfigView(m_snapshot, Find(key)); }
+
+string_view ConfigView::GetString(string_view key, string_view defaultValue) const
+{
+    const json* value = Find(key);
+    return value && value->is_string() ? string_view(value->get_ref<const string&>()) : defaultValue;
+}
+
+template <typename T>
+T ConfigView::GetNumber(string_view key, T defaultValue, ConfigUnit unit) const
+{
+    const json* parameter = Find(key);
+    T value;
+    return (parameter && JsonConfig::TryParseNumber(*parameter, value, unit)) ? value : defaultValue;
+}
+
+bool ConfigView::GetBool(string_view key, bool defaultValue) const
+{
+    const json* value = Find(key);
+    return value && value->is_boolean() ? value->get<bool>() : defaultValue;
+}
+
+ConfigKeyRange ConfigView::GetKeys(bool includeObjects, bool includeArrays, bool includeOthers) const
+{
+    const unsigned filter = (includeObjects ? ConfigKeyProjection::Objects : 0) | (includeArrays ? ConfigKeyProjection::Arrays : 0) |
+                            (includeOthers ? ConfigKeyProjection::Others : 0);
+    return ConfigKeyRange(m_snapshot, m_value, filter);
+}
+
+ConfigStringRange ConfigView::GetStrings(string_view key) const { return ConfigStringRange(m_snapshot, Find(key)); }
+
 // Explicit instantiation for specific types
-template int8_t JsonConfig::GetNumber(const string& path, const string& key, int8_t defaultValue);
-template uint8_t JsonConfig::GetNumber(const string& path, const string& key, uint8_t defaultValue);
+template int8_t JsonConfig::GetNumber(const string& path, const string& key, int8_t defaultValue, ConfigUnit unit);
+template uint8_t JsonConfig::GetNumber(const string& path, const string& key, uint8_t defaultValue, ConfigUnit unit);
+
+template int16_t JsonConfig::GetNumber(const string& path, const string& key, int16_t defaultValue, ConfigUnit unit);
+template uint16_t JsonConfig::GetNumber(const string& path, const string& key, uint16_t defaultValue, ConfigUnit unit);
+
+template int32_t JsonConfig::GetNumber(const string& path, const string& key, int32_t defaultValue, ConfigUnit unit);
+template uint32_t JsonConfig::GetNumber(const string& path, const string& key, uint32_t defaultValue, ConfigUnit unit);
+
+template int64_t JsonConfig::GetNumber(const string& path, const string& key, int64_t defaultValue, ConfigUnit unit);
+template uint64_t JsonConfig::GetNumber(const string& path, const string& key, uint64_t defaultValue, ConfigUnit unit);
+
+template double JsonConfig::GetNumber(const string& path, const string& key, double defaultValue, ConfigUnit unit);
+template float JsonConfig::GetNumber(const string& path, const string& key, float defaultValue, ConfigUnit unit);
+
+template int8_t JsonConfig::GetNumber(const ConfigPath& path, int8_t defaultValue, ConfigUnit unit);
+template uint8_t JsonConfig::GetNumber(const ConfigPath& path, uint8_t defaultValue, ConfigUnit unit);
+
+template int16_t JsonConfig::GetNumber(const ConfigPath& path, int16_t defaultValue, ConfigUnit unit);
+template uint16_t JsonConfig::GetNumber(const ConfigPath& path, uint16_t defaultValue, ConfigUnit unit);
+
+template int32_t JsonConfig::GetNumber(const ConfigPath& path, int32_t defaultValue, ConfigUnit unit);
+template uint32_t JsonConfig::GetNumber(const ConfigPath& path, uint32_t defaultValue, ConfigUnit unit);
+
+template int64_t JsonConfig::GetNumber(const ConfigPath& path, int64_t defaultValue, ConfigUnit unit);
+template uint64_t JsonConfig::GetNumber(const ConfigPath& path, uint64_t defaultValue, ConfigUnit unit);
+
+template double JsonConfig::GetNumber(const ConfigPath& path, double defaultValue, ConfigUnit unit);
+template float JsonConfig::GetNumber(const ConfigPath& path, float defaultValue, ConfigUnit unit);
+
+template int8_t ConfigView::GetNumber(string_view key, int8_t defaultValue, ConfigUnit unit) const;
+template uint8_t ConfigView::GetNumber(string_view key, uint8_t defaultValue, ConfigUnit unit) const;
+
+template int16_t ConfigView::GetNumber(string_view key, int16_t defaultValue, ConfigUnit unit) const;
+template uint16_t ConfigView::GetNumber(string_view key, uint16_t defaultValue, ConfigUnit unit) const;
+
+template int32_t ConfigView::GetNumber(string_view key, int32_t defaultValue, ConfigUnit unit) const;
+template uint32_t ConfigView::GetNumber(string_view key, uint32_t defaultValue, ConfigUnit unit) const;
+
+template int64_t ConfigView::GetNumber(string_view key, int64_t defaultValue, ConfigUnit unit) const;
+template uint64_t ConfigView::GetNumber(string_view key, uint64_t defaultValue, ConfigUnit unit) const;
+
+template double ConfigView::GetNumber(string_view key, double defaultValue, ConfigUnit unit) const;
+template float ConfigView::GetNumber(string_view key, float defaultValue, ConfigUnit unit) const;
+
+template bool JsonConfig::TryParseNumber(const json& parameter, int8_t& value, ConfigUnit unit);
+template bool JsonConfig::TryParseNumber(const json& parameter, uint8_t& value, ConfigUnit unit);
 
-template int16_t JsonConfig::GetNumber(const string& path, const string& key, int16_t defaultValue);
-template uint16_t JsonConfig::GetNumber(const string& path, const string& key, uint16_t defaultValue);
+template bool JsonConfig::TryParseNumber(const json& parameter, int16_t& value, ConfigUnit unit);
+template bool JsonConfig::TryParseNumber(const json& parameter, uint16_t& value, ConfigUnit unit);
 
-template int32_t JsonConfig::GetNumber(const string& path, const string& key, int32_t defaultValue);
-template uint32_t JsonConfig::GetNumber(const string& path, const string& key, uint32_t defaultValue);
+template bool JsonConfig::TryParseNumber(const json& parameter, int32_t& value, ConfigUnit unit);
+template bool JsonConfig::TryParseNumber(const json& parameter, uint32_t& value, ConfigUnit unit);
 
-template int64_t JsonConfig::GetNumber(const string& path, const string& key, int64_t defaultValue);
-template uint64_t JsonConfig::GetNumber(const string& path, const string& key, uint64_t defaultValue);
+template bool JsonConfig::TryParseNumber(const json& parameter, int64_t& value, ConfigUnit unit);
+template bool JsonConfig::TryParseNumber(const json& parameter, uint64_t& value, ConfigUnit unit);
 
-template double JsonConfig::GetNumber(const string& path, const string& key, double defaultValue);
-template float JsonConfig::GetNumber(const string& path, const string& key, float defaultValue);
+template bool JsonConfig::TryParseNumber(const json& parameter, double& value, ConfigUnit unit);
+template bool JsonConfig::TryParseNumber(const json& parameter, float& value, ConfigUnit unit);
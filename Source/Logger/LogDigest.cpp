@@ -0,0 +1,136 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#include <Logger/LogDigest.h>
+#include <Logger/LogFileTools.h>
+
+using namespace std;
+
+// the line, appended to each aggregated log
+constexpr size_t occurrencesLineLength = 100;
+
+LogDigest::LogDigest(bool aggregate) : m_aggregate(aggregate), m_recordCount(0), m_levelCounts{}, m_textLength(0) {}
+
+string LogDigest::GetKey(const LogRecord& record)
+{
+    // call site and level first, then the message template with each run of digits replaced by a single '#'
+    string key(reinterpret_cast<const char*>(&record.callSiteId), sizeof(record.callSiteId));
+    key += static_cast<char>(record.level);
+    key.reserve(key.length() + record.message.length());
+
+    bool inNumber = false;
+    for (const char c : record.message)
+    {
+        const bool digit = c >= '0' && c <= '9';
+        if (!digit)
+        {
+            key += c;
+        }
+        else if (!inNumber)
+        {
+            key += '#';
+        }
+        inNumber = digit;
+    }
+
+    return key;
+}
+
+bool LogDigest::Add(const LogRecord& record, LogMemoryBudget* memoryBudget, size_t& acquiredMemory)
+{
+    string key;
+    if (m_aggregate)
+    {
+        key = GetKey(record);
+        const auto it = m_index.find(key);
+        if (it != m_index.end())
+        {
+            // seen before, just remember when
+            auto& line = m_lines[it->second];
+            if (line.count == 1)
+            {
+                m_textLength += occurrencesLineLength;
+            }
+            line.count++;
+            line.lastTimestamp = GetLogTimestamp(record.formatted);
+            m_recordCount++;
+            m_levelCounts[record.level]++;
+            return true;
+        }
+    }
+
+    // a new line; errors and fatal errors are never dropped, even if we're over budget
+    const size_t cost = LogMemoryBudget::GetLineCost(record.formatted) + (m_aggregate ? key.length() + sizeof(Line) : 0);
+    if (memoryBudget && !memoryBudget->Acquire(cost, record.level >= LogLevel::Error))
+    {
+        // the budget counts the drops
+        return false;
+    }
+    acquiredMemory += cost;
+
+    if (m_aggregate)
+    {
+        m_index.emplace(std::move(key), m_lines.size());
+    }
+    m_lines.push_back({string(record.formatted), "", 1});
+    m_recordCount++;
+    m_levelCounts[record.level]++;
+    m_textLength += record.formatted.length();
+    return true;
+}
+
+string_view LogDigest::GetPiece(size_t index, string& scratch) const
+{
+    const auto& line = m_lines[index / 2];
+    if (index % 2 == 0)
+    {
+        return line.formatted;
+    }
+    if (line.count == 1)
+    {
+        return {};
+    }
+
+    scratch = "    (" + to_string(line.count) + " occurrences, first at " + string(GetLogTimestamp(line.formatted)) + ", last at " +
+              line.lastTimestamp + ")\n";
+    return scratch;
+}
+
+void LogDigest::WriteText(const function<void(string_view)>& writer, size_t maxLines) const
+{
+    string scratch;
+    const size_t pieces = maxLines > 0 ? min(maxLines * 2, GetPieceCount()) : GetPieceCount();
+    for (size_t i = 0; i < pieces; i++)
+    {
+        const auto piece = GetPiece(i, scratch);
+        if (!piece.empty())
+        {
+            writer(piece);
+        }
+    }
+}
@@ -0,0 +1,255 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+// Command line tool, which extracts a time range from the current and rotated log files. It uses the timestamp index
+// sidecars (see LogFileTools.h) to seek directly to the start of the range, instead of reading the files from the
+// beginning. Compressed (.gz) log files are supported through zlib, which also reads plain files transparently.
+// Build it together with Source/Logger/LogFileTools.cpp and link it with zlib.
+
+#include <iostream>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <Logger/LogFileTools.h>
+#include <zlib.h>
+
+#ifdef WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+// Reads plain or gzip-compressed log files line by line. For compressed files, seeking is emulated by zlib (the data
+// is still decompressed, but not parsed), while plain files are seeked directly.
+class LogFileReader
+{
+   public:
+    explicit LogFileReader(const std::filesystem::path& filePath)
+    {
+#ifdef WIN32
+        m_file = gzopen_w(filePath.c_str(), "rb");
+#else
+        m_file = gzopen(filePath.c_str(), "rb");
+#endif
+        if (m_file)
+        {
+            gzbuffer(m_file, 256 * 1024);
+        }
+    }
+
+    ~LogFileReader()
+    {
+        if (m_file)
+        {
+            gzclose(m_file);
+        }
+    }
+
+    LogFileReader(const LogFileReader&) = delete;
+    LogFileReader& operator=(const LogFileReader&) = delete;
+
+    bool IsOpen() const { return m_file != nullptr; }
+
+    bool Seek(uint64_t offset) { return gzseek(m_file, static_cast<z_off_t>(offset), SEEK_SET) >= 0; }
+
+    // Reads the next line, including the trailing newline; returns false at the end of the file.
+    bool ReadLine(std::string& line)
+    {
+        line.clear();
+        char buffer[16 * 1024];
+        while (gzgets(m_file, buffer, sizeof(buffer)))
+        {
+            line += buffer;
+            if (!line.empty() && line.back() == '\n')
+            {
+                break;
+            }
+        }
+        return !line.empty();
+    }
+
+   private:
+    gzFile m_file = nullptr;
+};
+
+struct LogFileInfo
+{
+    std::filesystem::path path;
+    std::string firstTimestamp;
+};
+
+void PrintUsage(const char* programName)
+{
+    std::cout << "Log Extract - extracts a time range from the current and rotated log files\n\n";
+    std::cout << "Usage: " << programName << " <log_file> <from> [<to>]\n\n";
+    std::cout << "Parameters:\n";
+    std::cout << "  log_file  Path to the current log file, as configured in the log section (filePath)\n";
+    std::cout << "  from      Start of the range, \"YYYY-MM-DD HH:MM:SS.mmm\" or any prefix of it\n";
+    std::cout << "  to        End of the range (inclusive), in the same format; default is the end of the logs\n\n";
+    std::cout << "Description:\n";
+    std::cout << "  The tool finds the rotated log files next to the current one (including the ones compressed\n";
+    std::cout << "  with gzip), orders them by time and writes the log lines within the range to the standard\n";
+    std::cout << "  output. The timestamp index files (*.idx), written by the logger, are used to skip the data\n";
+    std::cout << "  before the range; files without an index are read from the beginning.\n\n";
+    std::cout << "Example:\n";
+    std::cout << "  " << programName << " log\\SvcWatchDog.log \"2025-07-10 14:05\" \"2025-07-10 14:20\"\n\n";
+}
+
+// Finds the current and rotated log files (same rules as the logger uses for rotation), ordered by their first timestamp.
+std::vector<LogFileInfo> FindOrderedLogFiles(const std::filesystem::path& logFilePath)
+{
+    std::vector<LogFileInfo> files;
+    for (const auto& filePath : FindLogFiles(logFilePath))
+    {
+        // the first timestamp tells us where the file belongs
+        LogFileReader reader(filePath);
+        std::string line;
+        for (int i = 0; i < 100 && reader.IsOpen() && reader.ReadLine(line); i++)
+        {
+            const auto timestamp = GetLogTimestamp(line);
+            if (!timestamp.empty())
+            {
+                files.push_back({filePath, std::string(timestamp)});
+                break;
+            }
+        }
+    }
+
+    std::ranges::sort(files, {}, &LogFileInfo::firstTimestamp);
+    return files;
+}
+
+// Writes the lines within the range; returns false once the end of the range has been reached.
+bool ExtractRange(const LogFileInfo& file, const std::string& from, const std::string& to, uint64_t& skippedBytes)
+{
+    LogFileReader reader(file.path);
+    if (!reader.IsOpen())
+    {
+        std::cerr << "Warning: cannot open '" << file.path.string() << "', skipping it.\n";
+        return true;
+    }
+
+    // start at the last indexed line before the range; lines at the same millisecond could precede an entry, hence the strict comparison
+    const auto index = LoadLogIndex(GetLogIndexPath(file.path));
+    const auto it = std::ranges::lower_bound(index, from, {}, &LogIndexEntry::timestamp);
+    if (it != index.begin())
+    {
+        const uint64_t offset = std::prev(it)->offset;
+        if (reader.Seek(offset))
+        {
+            skippedBytes += offset;
+        }
+        else
+        {
+            std::cerr << "Warning: cannot seek in '" << file.path.string() << "', reading it from the beginning.\n";
+        }
+    }
+
+    std::string line;
+    bool inRange = false;
+    while (reader.ReadLine(line))
+    {
+        // lines without a timestamp belong to the previous (multi-line) log
+        const auto timestamp = GetLogTimestamp(line);
+        if (!timestamp.empty())
+        {
+            if (timestamp.substr(0, to.length()) > to)
+            {
+                return false;
+            }
+            inRange = timestamp >= from;
+        }
+
+        if (inRange)
+        {
+            std::cout.write(line.data(), static_cast<std::streamsize>(line.length()));
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3 && argc != 4)
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    const std::filesystem::path logFilePath = argv[1];
+    const std::string from = argv[2];
+    const std::string to = argc == 4 ? argv[3] : "9999";
+
+    if (!IsLogTimestampPrefix(from) || !IsLogTimestampPrefix(to))
+    {
+        std::cerr << "Error: invalid time range, use \"YYYY-MM-DD HH:MM:SS.mmm\" or any prefix of it.\n";
+        return 2;
+    }
+
+#ifdef WIN32
+    // the log lines already contain CR LF, so write them as they are
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    try
+    {
+        const auto files = FindOrderedLogFiles(logFilePath);
+        if (files.empty())
+        {
+            std::cerr << "Error: no log files found for '" << logFilePath.string() << "'.\n";
+            return 3;
+        }
+
+        uint64_t skippedBytes = 0;
+        size_t filesRead = 0;
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            if (i + 1 < files.size() && files[i + 1].firstTimestamp < from)
+            {
+                // the whole file is older than the range, since the next one starts before it
+                continue;
+            }
+
+            filesRead++;
+            if (!ExtractRange(files[i], from, to, skippedBytes))
+            {
+                break;
+            }
+        }
+
+        std::cout.flush();
+        std::cerr << filesRead << " of " << files.size() << " log files read, " << skippedBytes << " bytes skipped using the index\n";
+        return 0;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Unexpected error: " << e.what() << "\n";
+        return 9;
+    }
+}
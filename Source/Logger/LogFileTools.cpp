@@ -0,0 +1,143 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#include <Logger/LogFileTools.h>
+
+#include <fstream>
+#include <charconv>
+
+using namespace std;
+
+filesystem::path GetLogIndexPath(const filesystem::path& logFilePath)
+{
+    filesystem::path indexPath = logFilePath;
+    if (indexPath.extension() == ".gz")
+    {
+        indexPath.replace_extension();
+    }
+    indexPath += ".idx";
+    return indexPath;
+}
+
+string_view GetLogTimestamp(string_view line) noexcept
+{
+    // "YYYY-MM-DD HH:MM:SS.mmm" - check the separators and the digits
+    static constexpr string_view pattern = "0000-00-00 00:00:00.000";
+    if (line.length() < LOG_TIMESTAMP_LENGTH)
+    {
+        return {};
+    }
+
+    for (size_t i = 0; i < LOG_TIMESTAMP_LENGTH; i++)
+    {
+        const bool ok = pattern[i] == '0' ? (line[i] >= '0' && line[i] <= '9') : (line[i] == pattern[i]);
+        if (!ok)
+        {
+            return {};
+        }
+    }
+
+    return line.substr(0, LOG_TIMESTAMP_LENGTH);
+}
+
+bool IsLogTimestampPrefix(string_view text)
+{
+    // complete the prefix with a valid timestamp and check the result
+    static constexpr string_view completion = "2000-01-01 00:00:00.000";
+    return !text.empty() && text.length() <= completion.length() &&
+           !GetLogTimestamp(string(text) + string(completion.substr(text.length()))).empty();
+}
+
+vector<filesystem::path> FindLogFiles(const filesystem::path& logFilePath)
+{
+    // same rules as the logger uses when deleting the old files, plus the optional .gz extension
+    const auto folder = logFilePath.has_parent_path() ? logFilePath.parent_path() : filesystem::path(".");
+    const auto baseName = logFilePath.stem().string();
+    const auto extension = logFilePath.extension();
+
+    vector<filesystem::path> files;
+    for (const auto& entry : filesystem::directory_iterator(folder))
+    {
+        auto uncompressedPath = entry.path();
+        if (uncompressedPath.extension() == ".gz")
+        {
+            uncompressedPath.replace_extension();
+        }
+
+        if (entry.is_regular_file() && uncompressedPath.extension() == extension && uncompressedPath.stem().string().starts_with(baseName))
+        {
+            files.push_back(entry.path());
+        }
+    }
+
+    return files;
+}
+
+bool AppendLogIndex(const filesystem::path& indexPath, const vector<LogIndexEntry>& entries)
+{
+    if (entries.empty())
+    {
+        return true;
+    }
+
+    // binary mode, so the file looks the same everywhere
+    ofstream indexFile(indexPath, ios::app | ios::binary);
+    for (const auto& entry : entries)
+    {
+        indexFile << entry.timestamp << '\t' << entry.offset << '\n';
+    }
+
+    return indexFile.good();
+}
+
+vector<LogIndexEntry> LoadLogIndex(const filesystem::path& indexPath)
+{
+    vector<LogIndexEntry> entries;
+
+    ifstream indexFile(indexPath, ios::binary);
+    string line;
+    while (getline(indexFile, line))
+    {
+        const auto timestamp = GetLogTimestamp(line);
+        if (timestamp.empty() || line.length() < LOG_TIMESTAMP_LENGTH + 2 || line[LOG_TIMESTAMP_LENGTH] != '\t')
+        {
+            continue;
+        }
+
+        const char* first = line.data() + LOG_TIMESTAMP_LENGTH + 1;
+        const char* last = line.data() + line.length();
+        uint64_t offset = 0;
+        const auto [ptr, ec] = from_chars(first, last, offset);
+        if (ec == errc() && (ptr == last || *ptr == '\r'))
+        {
+            entries.push_back({string(timestamp), offset});
+        }
+    }
+
+    return entries;
+}
@@ -0,0 +1,493 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+// Command line tool, which searches the current and rotated log files in parallel and writes the matching logs in
+// chronological order. The files are memory mapped (compressed ones are decompressed into memory) and split into
+// chunks at log boundaries, so all cores can work on a single large file. The patterns are searched for in the whole
+// chunk rather than line by line, using the vectorized memchr/memcmp of the C runtime, and only the logs around the
+// hits are examined further.
+// Build it together with Source/Logger/LogFileTools.cpp and link it with zlib.
+
+#include <iostream>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <Logger/LogFileTools.h>
+#include <zlib.h>
+
+#ifdef WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+// chunk size for the parallel search; large enough to keep the per-chunk overhead negligible
+#define SEARCH_CHUNK_SIZE (4 * 1024 * 1024)
+
+struct SearchOptions
+{
+    std::vector<std::string> patterns;  // a log matches if it contains any of them
+    int minLevel = 0;
+    std::string from;
+    std::string to = "9999";
+    size_t threads = 0;
+    bool printFileName = false;
+};
+
+struct LogSource
+{
+    std::filesystem::path path;
+    MemoryMappedFile mapping;  // plain files
+    std::string decompressed;  // compressed files
+    std::string_view data;
+    std::string firstTimestamp;
+};
+
+struct Chunk
+{
+    size_t source;
+    size_t begin;               // chunks always start at the beginning of a log
+    size_t end;
+    std::string nextTimestamp;  // first timestamp of the next chunk in the same file, empty for the last chunk
+};
+
+struct Match
+{
+    std::string_view timestamp;
+    std::string_view log;  // complete log, including continuation lines and the trailing newline
+    size_t source;
+};
+
+static const char* const levelNames[] = {"VRB", "DBG", "INF", "WRN", "ERR", "FAT"};
+
+void PrintUsage(const char* programName)
+{
+    std::cout << "Log Search - searches the current and rotated log files in parallel\n\n";
+    std::cout << "Usage: " << programName << " [options] <log_file> [<pattern> ...]\n\n";
+    std::cout << "Parameters:\n";
+    std::cout << "  log_file  Path to the current log file, as configured in the log section (filePath)\n";
+    std::cout << "  pattern   Text to search for (case sensitive); logs matching any of the patterns are written,\n";
+    std::cout << "            without patterns all logs within the filters are written\n\n";
+    std::cout << "Options:\n";
+    std::cout << "  -l <level>  Minimum log level: VRB, DBG, INF, WRN, ERR or FAT\n";
+    std::cout << "  -f <from>   Start of the time range, \"YYYY-MM-DD HH:MM:SS.mmm\" or any prefix of it\n";
+    std::cout << "  -t <to>     End of the time range (inclusive), in the same format\n";
+    std::cout << "  -j <count>  Number of worker threads; default is the number of CPU cores\n";
+    std::cout << "  -p          Prefix each log with the name of the file it was found in\n\n";
+    std::cout << "Description:\n";
+    std::cout << "  The matching logs of all files (including the ones compressed with gzip) are written to the\n";
+    std::cout << "  standard output in chronological order. Multi-line logs are matched and written as a whole.\n\n";
+    std::cout << "Example:\n";
+    std::cout << "  " << programName << " -l WRN -f \"2025-07-10\" log\\SvcWatchDog.log \"restarting\" \"timeout\"\n\n";
+}
+
+// Runs the function for all indexes from 0 to count - 1, on the given number of threads.
+void ParallelFor(size_t count, size_t threads, const std::function<void(size_t)>& function)
+{
+    std::atomic<size_t> next = 0;
+    const auto worker = [&]()
+    {
+        for (size_t i = next++; i < count; i = next++)
+        {
+            function(i);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < std::min(threads, count); i++)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+
+    for (auto& thread : workers)
+    {
+        thread.join();
+    }
+}
+
+bool LoadCompressedFile(const std::filesystem::path& filePath, std::string& data)
+{
+#ifdef WIN32
+    gzFile file = gzopen_w(filePath.c_str(), "rb");
+#else
+    gzFile file = gzopen(filePath.c_str(), "rb");
+#endif
+    if (!file)
+    {
+        return false;
+    }
+
+    gzbuffer(file, 256 * 1024);
+    char buffer[256 * 1024];
+    int length = 0;
+    while ((length = gzread(file, buffer, sizeof(buffer))) > 0)
+    {
+        data.append(buffer, static_cast<size_t>(length));
+    }
+
+    gzclose(file);
+    return length == 0;
+}
+
+bool LoadSource(LogSource& source)
+{
+    if (source.path.extension() == ".gz")
+    {
+        if (!LoadCompressedFile(source.path, source.decompressed))
+        {
+            return false;
+        }
+        source.data = source.decompressed;
+    }
+    else
+    {
+        if (!source.mapping.Open(source.path))
+        {
+            return false;
+        }
+        source.data = source.mapping.GetView();
+    }
+
+    // the first timestamp tells us where the file belongs
+    for (size_t position = 0; position < source.data.length() && source.firstTimestamp.empty();)
+    {
+        source.firstTimestamp = GetLogTimestamp(source.data.substr(position));
+        const size_t newline = source.data.find('\n', position);
+        position = newline == std::string_view::npos ? source.data.length() : newline + 1;
+    }
+
+    return true;
+}
+
+// Returns the start of the first log at or after the position.
+size_t FindLogStart(std::string_view data, size_t position)
+{
+    if (position > 0 && data[position - 1] != '\n')
+    {
+        const size_t newline = data.find('\n', position);
+        position = newline == std::string_view::npos ? data.length() : newline + 1;
+    }
+
+    // skip continuation lines
+    while (position < data.length() && GetLogTimestamp(data.substr(position)).empty())
+    {
+        const size_t newline = data.find('\n', position);
+        position = newline == std::string_view::npos ? data.length() : newline + 1;
+    }
+
+    return position;
+}
+
+// Returns the start of the log containing the position.
+size_t FindContainingLogStart(std::string_view data, size_t position)
+{
+    size_t lineStart = data.rfind('\n', position);
+    lineStart = lineStart == std::string_view::npos ? 0 : lineStart + 1;
+    while (lineStart > 0 && GetLogTimestamp(data.substr(lineStart)).empty())
+    {
+        const size_t newline = lineStart >= 2 ? data.rfind('\n', lineStart - 2) : std::string_view::npos;
+        lineStart = newline == std::string_view::npos ? 0 : newline + 1;
+    }
+    return lineStart;
+}
+
+// Returns the end of the log containing the position (the start of the next log).
+size_t FindLogEnd(std::string_view data, size_t position)
+{
+    for (size_t newline = data.find('\n', position); newline != std::string_view::npos; newline = data.find('\n', newline + 1))
+    {
+        if (newline + 1 >= data.length() || !GetLogTimestamp(data.substr(newline + 1)).empty())
+        {
+            return newline + 1;
+        }
+    }
+    return data.length();
+}
+
+int GetLevel(std::string_view log)
+{
+    // "YYYY-MM-DD HH:MM:SS.mmm [INF] ..."
+    if (log.length() > LOG_TIMESTAMP_LENGTH + 5 && log[LOG_TIMESTAMP_LENGTH + 1] == '[')
+    {
+        const auto name = log.substr(LOG_TIMESTAMP_LENGTH + 2, 3);
+        for (int i = 0; i < static_cast<int>(std::size(levelNames)); i++)
+        {
+            if (name == levelNames[i])
+            {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+void SearchChunk(const LogSource& source, const Chunk& chunk, size_t sourceIndex, const SearchOptions& options, std::vector<Match>& matches)
+{
+    // skip the chunks completely outside of the time range
+    const std::string_view data = source.data.substr(chunk.begin, chunk.end - chunk.begin);
+    const auto firstTimestamp = GetLogTimestamp(data);
+    if ((!firstTimestamp.empty() && firstTimestamp.substr(0, options.to.length()) > options.to) ||
+        (!chunk.nextTimestamp.empty() && chunk.nextTimestamp < options.from))
+    {
+        return;
+    }
+
+    // collect the starts of the candidate logs
+    std::vector<size_t> logStarts;
+    if (options.patterns.empty())
+    {
+        for (size_t position = 0; position < data.length(); position = FindLogEnd(data, position))
+        {
+            logStarts.push_back(position);
+        }
+    }
+    else
+    {
+        for (const auto& pattern : options.patterns)
+        {
+            for (size_t hit = data.find(pattern); hit != std::string_view::npos;)
+            {
+                logStarts.push_back(FindContainingLogStart(data, hit));
+
+                // no need to look for more hits within the same log
+                const size_t end = FindLogEnd(data, hit);
+                hit = data.find(pattern, end);
+            }
+        }
+
+        if (options.patterns.size() > 1)
+        {
+            std::ranges::sort(logStarts);
+            const auto [first, last] = std::ranges::unique(logStarts);
+            logStarts.erase(first, last);
+        }
+    }
+
+    for (const size_t start : logStarts)
+    {
+        const auto log = data.substr(start, FindLogEnd(data, start) - start);
+        const auto timestamp = GetLogTimestamp(log);
+        if (timestamp.empty() || timestamp < options.from || timestamp.substr(0, options.to.length()) > options.to)
+        {
+            continue;
+        }
+
+        if (options.minLevel > 0 && GetLevel(log) < options.minLevel)
+        {
+            continue;
+        }
+
+        matches.push_back({timestamp, log, sourceIndex});
+    }
+}
+
+bool ParseArguments(int argc, char* argv[], SearchOptions& options, std::filesystem::path& logFilePath)
+{
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] != 0; i++)
+    {
+        const std::string option = argv[i];
+        if (option == "-p")
+        {
+            options.printFileName = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+
+        const std::string value = argv[++i];
+        if (option == "-l")
+        {
+            const auto it = std::ranges::find(levelNames, value);
+            if (it == std::end(levelNames))
+            {
+                return false;
+            }
+            options.minLevel = static_cast<int>(it - std::begin(levelNames));
+        }
+        else if (option == "-f" && IsLogTimestampPrefix(value))
+        {
+            options.from = value;
+        }
+        else if (option == "-t" && IsLogTimestampPrefix(value))
+        {
+            options.to = value;
+        }
+        else if (option == "-j" && std::stoi(value) > 0)
+        {
+            options.threads = static_cast<size_t>(std::stoi(value));
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (i >= argc)
+    {
+        return false;
+    }
+
+    logFilePath = argv[i++];
+    for (; i < argc; i++)
+    {
+        if (argv[i][0] != 0)
+        {
+            options.patterns.emplace_back(argv[i]);
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    SearchOptions options;
+    std::filesystem::path logFilePath;
+
+    try
+    {
+        if (!ParseArguments(argc, argv, options, logFilePath))
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    catch (const std::exception&)
+    {
+        // invalid number
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    if (options.threads == 0)
+    {
+        options.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+#ifdef WIN32
+    // the logs already contain CR LF, so write them as they are
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    try
+    {
+        // load (map or decompress) all files in parallel
+        const auto filePaths = FindLogFiles(logFilePath);
+        std::vector<std::unique_ptr<LogSource>> sources(filePaths.size());
+        std::atomic<size_t> failures = 0;
+        ParallelFor(sources.size(), options.threads,
+                    [&](size_t i)
+                    {
+                        sources[i] = std::make_unique<LogSource>();
+                        sources[i]->path = filePaths[i];
+                        if (!LoadSource(*sources[i]))
+                        {
+                            failures++;
+                        }
+                    });
+
+        if (failures > 0)
+        {
+            std::cerr << "Warning: " << failures << " log file(s) could not be read and were skipped.\n";
+        }
+
+        // order the files by time, so the matches of each file end up in order, and drop the unusable ones
+        std::erase_if(sources, [](const auto& source) { return source->firstTimestamp.empty(); });
+        std::ranges::stable_sort(sources, {}, [](const auto& source) { return std::string_view(source->firstTimestamp); });
+        if (sources.empty())
+        {
+            std::cerr << "Error: no log files found for '" << logFilePath.string() << "'.\n";
+            return 3;
+        }
+
+        // split the files into chunks at log boundaries
+        std::vector<Chunk> chunks;
+        uint64_t totalSize = 0;
+        for (size_t i = 0; i < sources.size(); i++)
+        {
+            const auto data = sources[i]->data;
+            totalSize += data.length();
+            for (size_t begin = FindLogStart(data, 0); begin < data.length();)
+            {
+                const size_t end = FindLogStart(data, std::min(begin + SEARCH_CHUNK_SIZE, data.length()));
+                if (!chunks.empty() && chunks.back().source == i)
+                {
+                    chunks.back().nextTimestamp = GetLogTimestamp(data.substr(begin));
+                }
+                chunks.push_back({i, begin, end, ""});
+                begin = end;
+            }
+        }
+
+        // search the chunks in parallel, each one into its own result
+        std::vector<std::vector<Match>> chunkMatches(chunks.size());
+        ParallelFor(chunks.size(), options.threads,
+                    [&](size_t i) { SearchChunk(*sources[chunks[i].source], chunks[i], chunks[i].source, options, chunkMatches[i]); });
+
+        // the chunks are in file and offset order, so a stable sort by timestamp keeps the logs with the same timestamp in their
+        // original order
+        std::vector<Match> matches;
+        for (auto& chunk : chunkMatches)
+        {
+            matches.insert(matches.end(), chunk.begin(), chunk.end());
+            std::vector<Match>().swap(chunk);
+        }
+        std::ranges::stable_sort(matches, {}, &Match::timestamp);
+
+        for (const auto& match : matches)
+        {
+            if (options.printFileName)
+            {
+                const auto fileName = sources[match.source]->path.filename().string();
+                std::cout.write(fileName.data(), static_cast<std::streamsize>(fileName.length()));
+                std::cout.write(": ", 2);
+            }
+            std::cout.write(match.log.data(), static_cast<std::streamsize>(match.log.length()));
+        }
+
+        std::cout.flush();
+        std::cerr << matches.size() << " matching logs in " << sources.size() << " files (" << totalSize << " bytes, " << chunks.size()
+                  << " chunks, " << options.threads << " threads)\n";
+        return 0;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Unexpected error: " << e.what() << "\n";
+        return 9;
+    }
+}
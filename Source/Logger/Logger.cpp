@@ -28,6 +28,7 @@
 
 #include <JsonConfig/JsonConfig.h>
 #include <Logger/Logger.h>
+#include <Logger/LogFileTools.h>
 
 #include <iostream>
 #include <fstream>
@@ -40,6 +41,73 @@
 using namespace std;
 
 Logger* Logger::m_instance = nullptr;
+thread_local bool PluginDeliveryScope::m_active = false;
+
+static uint64_t GetElapsedMicroseconds(chrono::steady_clock::time_point start) noexcept
+{
+    return TOUINT64(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count());
+}
+
+LogMemoryBudget::LogMemoryBudget() noexcept : m_limit(0), m_current(0), m_peak(0), m_dropped(0) {}
+
+void LogMemoryBudget::SetLimit(size_t limit) noexcept { m_limit = limit; }
+
+size_t LogMemoryBudget::GetLimit() const noexcept { return m_limit; }
+
+bool LogMemoryBudget::Acquire(size_t bytes, bool force) noexcept
+{
+    const size_t limit = m_limit.load(memory_order_relaxed);
+    const size_t usage = m_current.fetch_add(bytes, memory_order_relaxed) + bytes;
+    if (!force && limit > 0 && usage > limit)
+    {
+        // over budget - give the memory back and let the caller drop the item
+        m_current.fetch_sub(bytes, memory_order_relaxed);
+        m_dropped.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    // update the peak usage; a simple compare & swap loop is good enough, since it rarely needs to repeat
+    size_t peak = m_peak.load(memory_order_relaxed);
+    while (usage > peak && !m_peak.compare_exchange_weak(peak, usage, memory_order_relaxed))
+    {
+    }
+    return true;
+}
+
+void LogMemoryBudget::Release(size_t bytes) noexcept { m_current.fetch_sub(bytes, memory_order_relaxed); }
+
+size_t LogMemoryBudget::GetCurrentUsage() const noexcept { return m_current.load(memory_order_relaxed); }
+
+size_t LogMemoryBudget::GetPeakUsage() const noexcept { return m_peak.load(memory_order_relaxed); }
+
+uint64_t LogMemoryBudget::GetDroppedCount() const noexcept { return m_dropped.load(memory_order_relaxed); }
+
+bool LogMemoryBudget::IsUnderPressure() const noexcept
+{
+    const size_t limit = m_limit.load(memory_order_relaxed);
+    return limit > 0 && m_current.load(memory_order_relaxed) > limit / 2;
+}
+
+const char* GetLogLevelName(LogLevel level) noexcept
+{
+    switch (level)
+    {
+        case LogLevel::Verbose:
+            return "VRB";
+        case LogLevel::Debug:
+            return "DBG";
+        case LogLevel::Information:
+            return "INF";
+        case LogLevel::Warning:
+            return "WRN";
+        case LogLevel::Error:
+            return "ERR";
+        case LogLevel::Fatal:
+            return "FAT";
+        default:
+            return "UNK";
+    }
+}
 
 Logger::Logger() noexcept
     : m_minConsoleLevel(LogLevel::Verbose),
@@ -48,17 +116,33 @@ Logger::Logger() noexcept
       m_maxWriteDelay(0),
       m_maxOldFiles(0),
       m_logThreadId(false),
+      m_statisticsInterval(0),
+      m_indexInterval(0),
+      m_lastIndexOffset(UINT64_MAX),
+      m_reportedDrops(0),
+      m_cfg(nullptr),
+      m_subscription(0),
       m_mute(false),
-      m_fileQueue(std::make_unique<queue<string>>()),
-      m_emailTimestamp(0),
+      m_queue(std::make_unique<vector<QueuedRecord>>()),
       m_threadTrigger(false, true),  // initialize the event with auto-reset, although it's not strictly necessary here
       m_running(false)
 {
+    m_statistics.AddSink("console");
+    m_statistics.AddSink("file");
 }
 
 Logger::~Logger()
 {
+    if (m_subscription)
+    {
+        m_cfg->Unsubscribe(m_subscription);
+    }
     Shutdown();
+
+    // The plugins may own threads (for example the email delivery pool), which log until they're stopped. Destroying the
+    // plugins here, while we're still the instance, stops them before any of our members are gone.
+    m_plugins.clear();
+
     if (m_instance == this)
     {
         m_instance = nullptr;
@@ -81,13 +165,11 @@ void Logger::SetFileNamePostfix(const string& postfix) noexcept { m_fileNamePost
 
 void Logger::Configure(JsonConfig& cfg, const string& section)
 {
-    m_minConsoleLevel = (LogLevel)cfg.GetNumber(section, "minConsoleLevel", TOINT(LogLevel::Verbose));
-    m_minFileLevel = (LogLevel)cfg.GetNumber(section, "minFileLevel", TOINT(LogLevel::Verbose));
     const string tmp = cfg.GetString(section, "filePath", "");
     if (tmp.empty())
     {
-        // if no file path is provided, disable file logging
-        m_minFileLevel = MaskAllLogs;
+        // if no file path is provided, disable file logging (see ConfigureLive)
+        m_filePath.clear();
     }
     else
     {
@@ -103,14 +185,53 @@ void Logger::Configure(JsonConfig& cfg, const string& section)
         }
         filesystem::create_directories(m_filePath.parent_path());  // create the directory if it doesn't exist
     }
-    m_maxFileSize = cfg.GetNumber(section, "maxFileSize", 20 * 1024 * 1024);
-    m_maxWriteDelay = cfg.GetNumber(section, "maxWriteDelay", 500);
+    m_maxFileSize = cfg.GetNumber(section, "maxFileSize", 20 * 1024 * 1024, ConfigUnit::Bytes);
     m_maxOldFiles = cfg.GetNumber(section, "maxOldFiles", 0);
-
     m_logThreadId = cfg.GetBool(section, "logThreadId", false);
+    m_indexInterval = cfg.GetNumber(section, "indexInterval", 64);
+    ConfigureLive(cfg, section);
+
+    // the levels and the limits are applied again whenever the section changes
+    if (m_subscription)
+    {
+        m_cfg->Unsubscribe(m_subscription);
+    }
+    m_cfg = &cfg;
+    m_section = section;
+    m_subscription =
+        cfg.Subscribe(section, [this](const json* oldValue, const json* newValue) { OnConfigurationChanged(oldValue, newValue); });
+}
+
+void Logger::ConfigureLive(JsonConfig& cfg, const string& section)
+{
+    m_minConsoleLevel = (LogLevel)cfg.GetNumber(section, "minConsoleLevel", TOINT(LogLevel::Verbose));
+    m_minFileLevel = m_filePath.empty() ? MaskAllLogs : (LogLevel)cfg.GetNumber(section, "minFileLevel", TOINT(LogLevel::Verbose));
+    m_maxWriteDelay = cfg.GetNumber(section, "maxWriteDelay", 500, ConfigUnit::Milliseconds);
+    m_memoryBudget.SetLimit(TOSIZE(cfg.GetNumber<uint64_t>(section, "maxQueueMemory", 64 * 1024 * 1024, ConfigUnit::Bytes)));
+    m_statisticsInterval = cfg.GetNumber(section, "statisticsInterval", 0, ConfigUnit::Seconds);
+}
+
+void Logger::OnConfigurationChanged(const json* oldValue, const json* newValue)
+{
+    ConfigureLive(*m_cfg, m_section);
+    LOGSTR(Information) << m_section << " settings applied: minConsoleLevel=" << m_minConsoleLevel << ", minFileLevel=" << m_minFileLevel
+                        << ", maxWriteDelay=" << m_maxWriteDelay << ", maxQueueMemory=" << m_memoryBudget.GetLimit()
+                        << ", statisticsInterval=" << m_statisticsInterval;
+
+    // the email plugins take care of their own sections
+    const auto restartKeys = JsonConfig::GetChangedKeys(
+        oldValue, newValue, {"minConsoleLevel", "minFileLevel", "maxWriteDelay", "maxQueueMemory", "statisticsInterval", "email"});
+    if (!restartKeys.empty())
+    {
+        LOGSTR(Warning) << "changes of " << m_section << "." << JoinStrings(restartKeys, ", ") << " take effect after a restart";
+    }
 }
 
-void Logger::RegisterPlugin(unique_ptr<ILoggerPlugin> plugin) { m_plugins.emplace_back(std::move(plugin)); }
+void Logger::RegisterPlugin(unique_ptr<ILoggerPlugin> plugin)
+{
+    m_statistics.AddSink(plugin->Name());
+    m_plugins.emplace_back(std::move(plugin));
+}
 
 LogLevel Logger::GetMinPluginLevel()
 {
@@ -118,6 +239,20 @@ LogLevel Logger::GetMinPluginLevel()
     return (it != m_plugins.end()) ? (*it)->MinLogLevel() : MaskAllLogs;
 }
 
+LogMemoryBudget& Logger::GetMemoryBudget() noexcept { return m_memoryBudget; }
+
+LogStatisticsSnapshot Logger::GetStatistics() const
+{
+    auto snapshot = m_statistics.GetSnapshot();
+    snapshot.memoryUsage = m_memoryBudget.GetCurrentUsage();
+    snapshot.peakMemoryUsage = m_memoryBudget.GetPeakUsage();
+    for (size_t i = 0; i < m_plugins.size() && m_fileSink + 1 + i < snapshot.sinks.size(); i++)
+    {
+        snapshot.sinks[m_fileSink + 1 + i].status = m_plugins[i]->Status();
+    }
+    return snapshot;
+}
+
 void Logger::Start()
 {
     bool expected = false;
@@ -127,16 +262,27 @@ void Logger::Start()
 
         LOGSTR() << "minConsoleLevel=" << m_minConsoleLevel << ", minFileLevel=" << m_minFileLevel << ", filePath=" << m_filePath.string()
                  << ", maxFileSize=" << m_maxFileSize << ", maxOldFiles=" << m_maxOldFiles << ", maxWriteDelay=" << m_maxWriteDelay
-                 << ", logThreadId=" << BOOL2STR(m_logThreadId);
+                 << ", maxQueueMemory=" << m_memoryBudget.GetLimit() << ", logThreadId=" << BOOL2STR(m_logThreadId)
+                 << ", statisticsInterval=" << m_statisticsInterval << ", indexInterval=" << m_indexInterval;
     }
 }
 
 void Logger::Shutdown()
 {
+    if (m_running)
+    {
+        // log it while we're still running, otherwise the log would be ignored
+        LOGSTR() << "shutting down, peak queue memory usage " << m_memoryBudget.GetPeakUsage() << " bytes, "
+                 << m_memoryBudget.GetDroppedCount() << " logs dropped due to memory budget";
+        if (m_statisticsInterval > 0)
+        {
+            LOGSTR(Information) << "statistics: " << GetStatistics().SummaryText();
+        }
+    }
+
     bool expected = true;
     if (m_running.compare_exchange_strong(expected, false))
     {
-        LOGSTR() << "shutting down";
         m_threadTrigger.SetEvent();  // signal the thread to wake up and finish
         m_thread.join();
     }
@@ -148,49 +294,36 @@ void Logger::Mute(bool mute) noexcept { m_mute = mute; }
 
 void Logger::Log(LogLevel level, const string& message, const char* file, const char* func)
 {
-    if (m_mute || !m_running || (level < m_minConsoleLevel && level < m_minFileLevel && level < GetMinPluginLevel()))
+    // the plugins are only looked at while we're running; they are being destroyed after the shutdown
+    if (m_mute || !m_running)
+    {
+        return;
+    }
+    const LogLevel minPluginLevel = GetMinPluginLevel();
+    if (level < m_minConsoleLevel && level < m_minFileLevel && level < minPluginLevel)
     {
         return;
     }
 
     // if file and function are provided, use them to get the location prefix
-    const string locationPrefix = (file && func) ? (GetLocationPrefix(file, func) + ": ") : "";
+    const string location = (file && func) ? GetLocationPrefix(file, func) : "";
+    const string locationPrefix = location.empty() ? "" : location + ": ";
+
+    // string literals have static storage, so their addresses identify the call site within the running process
+    const uint64_t callSiteId = (file && func) ? ((std::hash<const void*>{}(file) * 31) ^ std::hash<const void*>{}(func)) : 0;
 
     struct tm localTime = {};
     int milliseconds = 0;
-    GetCurrentLocalTime(localTime, milliseconds);
+    const auto timestamp = GetCurrentLocalTime(localTime, milliseconds);
 
-    const char* levelName = nullptr;
-    switch (level)
-    {
-        case LogLevel::Verbose:
-            levelName = "VRB";
-            break;
-        case LogLevel::Debug:
-            levelName = "DBG";
-            break;
-        case LogLevel::Information:
-            levelName = "INF";
-            break;
-        case LogLevel::Warning:
-            levelName = "WRN";
-            break;
-        case LogLevel::Error:
-            levelName = "ERR";
-            break;
-        case LogLevel::Fatal:
-            levelName = "FAT";
-            break;
-        default:
-            levelName = "UNK";
-            break;
-    }
+    const char* levelName = GetLogLevelName(level);
+
+    // get the thread id - we deliberately truncate the hash to 32 bits, because it should be good enough for our purposes.
+    const uint32_t threadIdHash = (uint32_t)std::hash<std::thread::id>{}(std::this_thread::get_id());
 
     char threadIdPrefix[16] = "";
     if (m_logThreadId)
     {
-        // get the thread id - we deliberately truncate the hash to 32 bits, because it should be good enough for our purposes.
-        const uint32_t threadIdHash = (uint32_t)std::hash<std::thread::id>{}(std::this_thread::get_id());
         // convert it to a string
 #ifdef WIN32
 #pragma warning(suppress : 6031)
@@ -220,28 +353,53 @@ void Logger::Log(LogLevel level, const string& message, const char* file, const
     }
     fullMessage.resize(actualLength);
 
+    // remember where the location and the message are, so the plugins don't need to parse the line (the offsets are clamped just in
+    // case the line got truncated)
+    const size_t headerLength = TOSIZE(max(0, actualLength - TOINT(locationPrefix.length() + message.length()) - 1));
+    const auto clampOffset = [&fullMessage](size_t offset) { return TOUINT32(min(offset, fullMessage.length())); };
+
+    QueuedRecord record{level,
+                        timestamp,
+                        callSiteId,
+                        threadIdHash,
+                        clampOffset(headerLength),
+                        TOUINT32(location.length()),
+                        clampOffset(headerLength + locationPrefix.length()),
+                        PluginDeliveryScope::IsActive(),
+                        std::move(fullMessage)};
+    record.moduleLength = min(record.moduleLength, TOUINT32(record.text.length()) - record.moduleOffset);
+
+    // the counters are sharded per thread, so we don't need the lock for them
+    m_statistics.CountRecord(TOSIZE(level), record.text.length());
+
     // now obtain the lock to avoid messing up the output or crashing the queue when multiple threads are logging
     const lock_guard<mutex> lock(m_cs);
 
     // console output
     if (m_minConsoleLevel <= level)
     {
-        cout << fullMessage;
+        cout << record.text;
+        m_statistics.CountSinkRecords(m_consoleSink, 1, record.text.length());
     }
 
-    // plugin output
-    for (auto& plugin : m_plugins)
+    // queue the record for the file output and the plugins (a single copy is shared by all of them); errors and fatal errors are never
+    // dropped, even if we're over budget
+    if (m_minFileLevel <= level || minPluginLevel <= level)
     {
-        if (level >= plugin->MinLogLevel())
+        if (m_memoryBudget.Acquire(record.GetCost(), level >= LogLevel::Error))
         {
-            plugin->Log(level, fullMessage);
+            m_queue->push_back(std::move(record));
+        }
+        else
+        {
+            m_statistics.CountDrop(TOSIZE(level));
         }
     }
 
-    // file output
-    if (m_minFileLevel <= level)
+    if (m_memoryBudget.IsUnderPressure())
     {
-        m_fileQueue->push(std::move(fullMessage));
+        // wake up the logger thread, so it flushes the queues before the budget is exhausted
+        m_threadTrigger.SetEvent();
     }
 }
 
@@ -278,19 +436,19 @@ void Logger::Msg(LogLevel level, const char* pszFmt, ...)
 
 void Logger::Thread()
 {
+    uint64_t lastStatisticsTime = SteadyTime();
+
     while (m_running)
     {
-        if (m_threadTrigger.WaitForSingleEvent(m_maxWriteDelay))
-        {
-            if (m_running)
-            {
-                // strange - the wait succeeded although we're not shutting down
-                // let's sleep for a while to prevent busy waiting (not really needed)
-                SLEEP(m_maxWriteDelay);
+        // The event is signaled either when we're shutting down or when the memory budget is under pressure. In both cases, we simply
+        // flush the queues (again).
+        m_threadTrigger.WaitForSingleEvent(m_maxWriteDelay);
 
-                // NOTE: this should never happen, hence assert
-                assert(0);
-            }
+        if (m_statisticsInterval > 0 && m_running && SteadyTime() - lastStatisticsTime >= TOUINT64(m_statisticsInterval) * 1000)
+        {
+            // the summary goes through the regular queue, so it is flushed right below
+            LOGSTR(Information) << "statistics: " << GetStatistics().SummaryText();
+            lastStatisticsTime = SteadyTime();
         }
 
         Flush(false);
@@ -299,9 +457,22 @@ void Logger::Thread()
 
 void Logger::Flush(bool force)
 {
+    // only one flush at a time, otherwise the file and the plugins could receive the records out of order
+    const lock_guard<mutex> flushLock(m_flushCs);
+
+    std::unique_ptr<std::vector<QueuedRecord>> records;
+    {
+        const lock_guard<mutex> lock(m_cs);
+        records = std::move(m_queue);
+        m_queue = std::make_unique<vector<QueuedRecord>>();
+
+        // we're done with m_queue, it is now freshly initialized
+        // let's unlock the logger and write the data to the file and the plugins
+    }
+
     try
     {
-        FlushFileQueue();
+        FlushFileQueue(*records);
     }
     catch (const std::exception& e)
     {
@@ -315,12 +486,33 @@ void Logger::Flush(bool force)
         // For the time being, we're just catching the exception and hope it was temporary.
     }
 
+    DispatchToPlugins(*records);
+
+    // the records are gone now, so we can return their memory to the budget
+    size_t cost = 0;
+    for (const auto& record : *records)
+    {
+        cost += record.GetCost();
+    }
+    m_memoryBudget.Release(cost);
+
+    // report dropped logs, if any
+    const uint64_t droppedCount = m_memoryBudget.GetDroppedCount();
+    if (droppedCount != m_reportedDrops)
+    {
+        LOGSTR(Warning) << droppedCount - m_reportedDrops << " logs dropped due to memory budget (maxQueueMemory="
+                        << m_memoryBudget.GetLimit() << ")";
+        m_reportedDrops = droppedCount;
+    }
+
     // flush plugins
-    for (auto& plugin : m_plugins)
+    for (size_t i = 0; i < m_plugins.size(); i++)
     {
         try
         {
-            plugin->Flush(m_running, force);
+            const auto start = chrono::steady_clock::now();
+            m_plugins[i]->Flush(m_running, force);
+            m_statistics.CountSinkFlush(m_fileSink + 1 + i, GetElapsedMicroseconds(start));
         }
         catch (const std::exception& e)
         {
@@ -336,39 +528,122 @@ void Logger::Flush(bool force)
     }
 }
 
-void Logger::FlushFileQueue()
+void Logger::DispatchToPlugins(const vector<QueuedRecord>& records)
 {
-    std::unique_ptr<std::queue<std::string>> queueCopy;
+    if (m_plugins.empty() || records.empty())
+    {
+        return;
+    }
 
+    // prepare the views once for all plugins
+    vector<LogRecord> batch;
+    batch.reserve(records.size());
+    for (const auto& record : records)
     {
-        const lock_guard<mutex> lock(m_cs);
+        const string_view text(record.text);
+        const size_t messageLength = text.length() - record.messageOffset - (text.ends_with('\n') ? 1 : 0);
+        batch.push_back({record.level, record.timestamp, record.callSiteId, text.substr(record.moduleOffset, record.moduleLength),
+                         record.threadId, text.substr(record.messageOffset, messageLength), text, record.pluginDelivery});
+    }
 
-        if (m_fileQueue->empty())
+    for (size_t i = 0; i < m_plugins.size(); i++)
+    {
+        // count the records the plugin is interested in; if it throws, we consider them dropped
+        const size_t sink = m_fileSink + 1 + i;
+        const LogLevel minLogLevel = m_plugins[i]->MinLogLevel();
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+        for (const auto& record : batch)
+        {
+            if (record.level >= minLogLevel)
+            {
+                count++;
+                bytes += record.formatted.length();
+            }
+        }
+
+        try
+        {
+            m_plugins[i]->LogBatch(batch);
+            m_statistics.CountSinkRecords(sink, count, bytes);
+        }
+        catch (const std::exception& e)
+        {
+            // we can't afford to properly log exceptions here, because it might push us into a loop.
+            LogErrorToConsole("Logger::Thread: exception while passing logs to plugin: " + string(e.what()));
+            m_statistics.CountSinkDrops(sink, count);
+        }
+        catch (...)
         {
-            return;
+            LogErrorToConsole("Logger::Thread: unknown exception while passing logs to plugin");
+            m_statistics.CountSinkDrops(sink, count);
         }
+    }
+}
+
+void Logger::FlushFileQueue(const vector<QueuedRecord>& records)
+{
+    // the queue also contains the records, meant only for the plugins
+    if (ranges::none_of(records, [this](const QueuedRecord& record) { return record.level >= m_minFileLevel; }))
+    {
+        return;
+    }
 
-        queueCopy = std::move(m_fileQueue);
-        m_fileQueue = std::make_unique<queue<string>>();
+    const auto start = chrono::steady_clock::now();
 
-        // we're done with m_fileQueue, it is now freshly initialized
-        // let's unlock the logger and write the data to the f
+    // the file is written in text mode, so we track the offset ourselves; we only need it for the timestamp index
+    error_code ec;
+    uint64_t offset = filesystem::file_size(m_filePath, ec);
+    if (ec)
+    {
+        offset = 0;
+    }
+    const uint64_t indexInterval = TOUINT64(max(m_indexInterval, 0)) * 1024;
+    const auto indexPath = GetLogIndexPath(m_filePath);
+    vector<LogIndexEntry> indexEntries;
+    if (offset == 0)
+    {
+        // a new (or externally truncated) log file - any existing index is stale
+        filesystem::remove(indexPath, ec);
+        m_lastIndexOffset = UINT64_MAX;
     }
 
     // open the file in append mode (without holding the lock)
     std::ofstream outFile(m_filePath, std::ios::app);
 
-    if (outFile.is_open())
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+    for (const auto& record : records)
     {
-        // outFile << buffer;
-        while (!queueCopy->empty())
+        if (record.level >= m_minFileLevel)
         {
-            outFile << queueCopy->front();  // write to the file
-            queueCopy->pop();
+            count++;
+            bytes += record.text.length();
+            if (outFile.is_open())
+            {
+                if (indexInterval > 0 && (m_lastIndexOffset == UINT64_MAX || offset >= m_lastIndexOffset + indexInterval))
+                {
+                    // time for a new index entry; the timestamp is at the start of each log line
+                    indexEntries.push_back({record.text.substr(0, LOG_TIMESTAMP_LENGTH), offset});
+                    m_lastIndexOffset = offset;
+                }
+
+                outFile << record.text;  // write to the file
+                offset += record.text.length();
+#ifdef WIN32
+                offset += ranges::count(record.text, '\n');  // each newline becomes CR LF
+#endif
+            }
         }
     }
+
+    if (outFile.is_open())
+    {
+        m_statistics.CountSinkRecords(m_fileSink, count, bytes);
+    }
     else
     {
+        m_statistics.CountSinkDrops(m_fileSink, count);
         LogErrorToConsole("Logger: unable to open file " + m_filePath.string() + " for writing");
 
         // it's worth trying to create the folder again, although it should already exist
@@ -378,6 +653,13 @@ void Logger::FlushFileQueue()
     const auto fileSize = outFile.tellp();
     outFile.close();
 
+    if (!AppendLogIndex(indexPath, indexEntries))
+    {
+        LogErrorToConsole("Logger: unable to write index file " + indexPath.string());
+    }
+
+    m_statistics.CountSinkFlush(m_fileSink, GetElapsedMicroseconds(start));
+
     // rotate file if needed
     if (m_maxFileSize > 0 && fileSize > m_maxFileSize)
     {
@@ -399,6 +681,13 @@ void Logger::FlushFileQueue()
         auto newFileName = m_filePath.parent_path() / (baseName.string() + "." + timestamp + extension.string());
         filesystem::rename(m_filePath, newFileName);
 
+        // the index goes along with the file, while the new file starts without one
+        if (filesystem::exists(indexPath, ec))
+        {
+            filesystem::rename(indexPath, GetLogIndexPath(newFileName), ec);
+        }
+        m_lastIndexOffset = UINT64_MAX;
+
         // remove old files if needed
         if (m_maxOldFiles > 0)
         {
@@ -424,12 +713,27 @@ void Logger::FlushFileQueue()
                 for (size_t i = 0; i < oldFiles.size() - m_maxOldFiles; i++)
                 {
                     filesystem::remove(oldFiles[i]);
+                    filesystem::remove(GetLogIndexPath(oldFiles[i]), ec);
                 }
             }
         }
     }
 }
 
+void ILoggerPlugin::LogBatch(span<const LogRecord> records)
+{
+    const LogLevel minLogLevel = MinLogLevel();
+    for (const auto& record : records)
+    {
+        if (record.level >= minLogLevel)
+        {
+            Log(record.level, string(record.formatted));
+        }
+    }
+}
+
+void ILoggerPlugin::Log(LogLevel, const string&) {}
+
 LoggerStream::LoggerStream() noexcept : m_file(nullptr), m_func(nullptr), m_level(LogLevel::Debug) {}
 
 std::ostringstream& LoggerStream::Get(LogLevel level) noexcept
@@ -28,32 +28,132 @@
 
 #include <JsonConfig/JsonConfig.h>
 #include <Logger/LoggerEmailPlugin.h>
+#include <SimpleTools/GzipCompressor.h>
 
 #include <iostream>
 #include <chrono>
 
 using namespace std;
 
+namespace
+{
+// Email body, streamed straight from the digest, so the logs never have to be joined into one big string.
+class LogDigestEmailBody : public IEmailBody
+{
+   public:
+    explicit LogDigestEmailBody(unique_ptr<LogDigest> logs) : m_logs(std::move(logs)) {}
+
+    size_t GetPieceCount() const override { return m_logs->GetPieceCount(); }
+    string_view GetPiece(size_t index, string& scratch) const override { return m_logs->GetPiece(index, scratch); }
+
+   private:
+    unique_ptr<const LogDigest> m_logs;
+};
+
+// Email body, which keeps the memory of its logs acquired from the logger's memory budget until the delivery pool is done with the
+// email (delivered, spooled or dropped) and destroys it.
+class BudgetedEmailBody : public IEmailBody
+{
+   public:
+    BudgetedEmailBody(shared_ptr<const IEmailBody> body, LogMemoryBudget* memoryBudget, size_t memory) noexcept
+        : m_body(std::move(body)),
+          m_memoryBudget(memoryBudget),
+          m_memory(memory)
+    {
+    }
+    ~BudgetedEmailBody() override { m_memoryBudget->Release(m_memory); }
+
+    // prevent copying and assignment
+    DELETE_COPY_AND_ASSIGNMENT(BudgetedEmailBody);
+
+    size_t GetPieceCount() const override { return m_body->GetPieceCount(); }
+    string_view GetPiece(size_t index, string& scratch) const override { return m_body->GetPiece(index, scratch); }
+
+   private:
+    shared_ptr<const IEmailBody> m_body;
+    LogMemoryBudget* m_memoryBudget;
+    size_t m_memory;
+};
+
+// Returns the name of the attachment, for example logs-20250710-140512-345.txt.gz; each email gets its own name, so the saved
+// attachments don't overwrite each other.
+string GetAttachmentName()
+{
+    struct tm localTime = {};
+    int milliseconds = 0;
+    GetCurrentLocalTime(localTime, milliseconds);
+
+    char name[64];
+#ifdef WIN32
+#pragma warning(suppress : 6031)
+#endif
+    snprintf(name, sizeof(name) - 1, "logs-%04d%02d%02d-%02d%02d%02d-%03d.txt.gz", localTime.tm_year + 1900, localTime.tm_mon + 1,
+             localTime.tm_mday, localTime.tm_hour, localTime.tm_min, localTime.tm_sec, milliseconds);
+    AUTO_TERMINATE(name);
+    return name;
+}
+}  // namespace
+
 void LoggerEmailPlugin::ConfigureAll(JsonConfig& cfg, Logger& logger, const string& parentSection)
 {
-    // find all sections of parentSection and configure a LoggerEmailPlugin for each of them.
-    auto sections = cfg.GetKeys(parentSection, true, false, false);
-    for (auto& section : sections)
+    // find all sections of parentSection and configure a LoggerEmailPlugin for each of them; the view keeps the snapshot, which
+    // the keys are read from, alive
+    const ConfigView parent = cfg.GetView(parentSection);
+    const auto sections = parent.GetKeys(true, false, false);
+    if (sections.empty())
     {
-        logger.RegisterPlugin(make_unique<LoggerEmailPlugin>(cfg, parentSection + "." + section));
+        return;
     }
+
+    // all plugins share the same delivery pool (and spool, if any), configured in the parent section; like the logs of the
+    // delivery, the logs of the email stack's configuration are not sent by email
+    shared_ptr<EmailDeliveryPool> deliveryPool;
+    {
+        const PluginDeliveryScope deliveryScope;
+        unique_ptr<EmailSpool> spool;
+        const string spoolDir = cfg.GetString(parentSection, "spoolDir", "");
+        if (!spoolDir.empty())
+        {
+            spool = make_unique<EmailSpool>(filesystem::absolute(spoolDir),
+                                            cfg.GetNumber<uint64_t>(parentSection, "maxSpoolSize", 10 * 1024 * 1024, ConfigUnit::Bytes),
+                                            cfg.GetNumber(parentSection, "retryDelay", 60000, ConfigUnit::Milliseconds),
+                                            cfg.GetNumber(parentSection, "maxRetryDelay", 3600000, ConfigUnit::Milliseconds),
+                                            cfg.GetNumber<uint64_t>(parentSection, "maxSpoolAge", 604800000, ConfigUnit::Milliseconds));
+        }
+        deliveryPool = make_shared<EmailDeliveryPool>(TOSIZE(cfg.GetNumber(parentSection, "maxConcurrentDeliveries", 8)),
+                                                      TOSIZE(cfg.GetNumber(parentSection, "maxPendingEmails", 100)), std::move(spool),
+                                                      cfg.GetNumber(parentSection, "timeoutOnShutdown", 3000, ConfigUnit::Milliseconds));
+    }
+
+    for (const string_view section : sections)
+    {
+        logger.RegisterPlugin(
+            make_unique<LoggerEmailPlugin>(cfg, parentSection + "." + string(section), deliveryPool, &logger.GetMemoryBudget()));
+    }
+
+    // the spooled emails of the plugins which are not configured anymore are never delivered
+    const PluginDeliveryScope deliveryScope;
+    deliveryPool->ReportOrphans();
 }
 
-LoggerEmailPlugin::LoggerEmailPlugin(JsonConfig& cfg, const string& section)
-    : m_queue(std::make_unique<queue<string>>()), m_queueTimestamp(0)
+LoggerEmailPlugin::LoggerEmailPlugin(JsonConfig& cfg, const string& section, shared_ptr<EmailDeliveryPool> deliveryPool,
+                                     LogMemoryBudget* memoryBudget)
+    : m_section(section),
+      m_emailSender(make_shared<EmailSender>()),
+      m_deliveryPool(std::move(deliveryPool)),
+      m_queueTimestamp(0),
+      m_urgentTimestamp(0),
+      m_queueMemory(0),
+      m_memoryBudget(memoryBudget),
+      m_cfg(&cfg),
+      m_subscription(0)
 {
-    m_minLogLevel = (LogLevel)cfg.GetNumber(section, "minLogLevel", (int)LogLevel::Verbose);
-    m_recipients = cfg.GetStringVector(section, "recipients");
-    m_subject = cfg.GetString(section, "subject", "");
+    ConfigureLive(cfg);
     m_emailSection = cfg.GetString(section, "emailSection", "");
-    m_maxDelay = cfg.GetNumber(section, "maxDelay", 300);
-    m_maxLogs = cfg.GetNumber(section, "maxLogs", 1000);
-    m_timeoutOnShutdown = cfg.GetNumber(section, "timeoutOnShutdown", 3000);
+    m_timeoutOnShutdown = cfg.GetNumber(section, "timeoutOnShutdown", 3000, ConfigUnit::Milliseconds);
+    m_digest = cfg.GetBool(section, "digest", false);
+    m_attachmentThreshold = TOSIZE(cfg.GetNumber<uint64_t>(section, "attachmentThreshold", 0, ConfigUnit::Bytes));
+    m_queue = make_unique<LogDigest>(m_digest);
 
     if (m_emailSection.empty() || m_recipients.empty() || m_minLogLevel >= MaskAllLogs)
     {
@@ -66,39 +166,118 @@ LoggerEmailPlugin::LoggerEmailPlugin(JsonConfig& cfg, const string& section)
     }
     else
     {
-        if (m_subject.empty())
         {
-            // provide a portable default subject in the form of "logs from software @ host"
-            m_subject = GetExecutableName() + " @ " + GetHostname();
+            const PluginDeliveryScope deliveryScope;
+            m_emailSender->Configure(cfg, m_emailSection);
+            if (!m_deliveryPool)
+            {
+                m_deliveryPool = make_shared<EmailDeliveryPool>(1, 100, nullptr, m_timeoutOnShutdown);
+            }
         }
-
-        m_emailSender.Configure(cfg, m_emailSection);
+        // the section name identifies our emails in the spool, even after a restart
+        m_deliveryPool->RegisterOwner(this, m_section, m_emailSender);
 
         LOGSTR() << "section=" << section << ": minLogLevel=" << m_minLogLevel << ", emailSection=" << m_emailSection
                  << ", recipients=" << JoinStrings(m_recipients, ", ") << ", subject=" << m_subject << ", maxDelay=" << m_maxDelay
-                 << ", maxLogs=" << m_maxLogs << ", timeoutOnShutdown=" << m_timeoutOnShutdown;
+                 << ", maxLogs=" << m_maxLogs << ", urgentLevel=" << m_urgentLevel << ", urgentDelay=" << m_urgentDelay
+                 << ", timeoutOnShutdown=" << m_timeoutOnShutdown << ", digest=" << BOOL2STR(m_digest)
+                 << ", attachmentThreshold=" << m_attachmentThreshold;
+
+        // the recipients, the subject, the levels and the delays are applied again whenever the section changes
+        m_subscription =
+            cfg.Subscribe(section, [this](const json* oldValue, const json* newValue) { OnConfigurationChanged(oldValue, newValue); });
     }
 }
 
-LoggerEmailPlugin::~LoggerEmailPlugin() = default;
-
-LogLevel LoggerEmailPlugin::MinLogLevel() { return m_minLogLevel; }
+void LoggerEmailPlugin::ConfigureLive(JsonConfig& cfg)
+{
+    m_minLogLevel = (LogLevel)cfg.GetNumber(m_section, "minLogLevel", (int)LogLevel::Verbose);
+    m_recipients = cfg.GetStringVector(m_section, "recipients");
+    m_subject = cfg.GetString(m_section, "subject", "");
+    if (m_subject.empty())
+    {
+        // provide a portable default subject in the form of "logs from software @ host"
+        m_subject = GetExecutableName() + " @ " + GetHostname();
+    }
+    m_maxDelay = cfg.GetNumber(m_section, "maxDelay", 300, ConfigUnit::Seconds);
+    m_maxLogs = cfg.GetNumber(m_section, "maxLogs", 1000);
+    m_urgentLevel = (LogLevel)cfg.GetNumber(m_section, "urgentLevel", (int)LogLevel::MaskAllLogs);
+    m_urgentDelay = cfg.GetNumber(m_section, "urgentDelay", 2000, ConfigUnit::Milliseconds);
+}
 
-void LoggerEmailPlugin::Log(LogLevel level, const string& message)
+void LoggerEmailPlugin::OnConfigurationChanged(const json* oldValue, const json* newValue)
 {
-    if (level < m_minLogLevel)
+    // email logging can only be switched on and off by a restart
+    if (m_cfg->GetStringVector(m_section, "recipients").empty())
     {
+        LOGSTR(Error) << "section=" << m_section << ": no recipients, keeping the previous settings";
         return;
     }
 
-    // we deliberately ignore the logs from EmailSender, because we don't want them to start an email sending loop
-    if (m_minLogLevel <= level && message.find("EmailSender") == string::npos)
     {
-        if (m_queue->empty())
+        const lock_guard<mutex> lock(m_cs);
+        ConfigureLive(*m_cfg);
+    }
+
+    // we're the only writer, so there is no need to lock while reading
+    LOGSTR() << "section=" << m_section << ": settings applied: minLogLevel=" << m_minLogLevel
+             << ", recipients=" << JoinStrings(m_recipients, ", ") << ", subject=" << m_subject << ", maxDelay=" << m_maxDelay
+             << ", maxLogs=" << m_maxLogs << ", urgentLevel=" << m_urgentLevel << ", urgentDelay=" << m_urgentDelay;
+
+    const auto restartKeys = JsonConfig::GetChangedKeys(
+        oldValue, newValue, {"minLogLevel", "recipients", "subject", "maxDelay", "maxLogs", "urgentLevel", "urgentDelay"});
+    if (!restartKeys.empty())
+    {
+        LOGSTR(Warning) << "section=" << m_section << ": changes of " << JoinStrings(restartKeys, ", ") << " take effect after a restart";
+    }
+}
+
+LoggerEmailPlugin::~LoggerEmailPlugin()
+{
+    if (m_subscription)
+    {
+        m_cfg->Unsubscribe(m_subscription);
+    }
+
+    if (m_memoryBudget)
+    {
+        // return whatever is still queued (normally nothing, since the logger flushes us on shutdown)
+        m_memoryBudget->Release(m_queueMemory);
+    }
+}
+
+LogLevel LoggerEmailPlugin::MinLogLevel() { return m_minLogLevel; }
+
+string LoggerEmailPlugin::Name() { return m_section; }
+
+string LoggerEmailPlugin::Status() { return m_emailSection.empty() ? "" : "SMTP " + m_emailSender->GetCircuitBreaker().GetStatusText(); }
+
+void LoggerEmailPlugin::LogBatch(span<const LogRecord> records)
+{
+    // LogBatch and Flush are normally called from the same thread, but Logger::Flush might be called from elsewhere, too
+    const lock_guard<mutex> lock(m_cs);
+
+    for (const auto& record : records)
+    {
+        // we deliberately ignore the logs of the email delivery, because we don't want them to start an email sending loop
+        if (record.level < m_minLogLevel || record.pluginDelivery)
+        {
+            continue;
+        }
+
+        if (m_queue->IsEmpty())
         {
             m_queueTimestamp = SteadyTime();
         }
-        m_queue->push(message);
+
+        // repeated lines are merged, so they don't take any additional memory; over budget, new lines are dropped
+        m_queue->Add(record, m_memoryBudget, m_queueMemory);
+
+        if (record.level >= m_urgentLevel && m_urgentTimestamp == 0)
+        {
+            // the email goes out shortly, together with whatever else arrives in the meantime
+            m_urgentTimestamp = SteadyTime();
+        }
     }
 }
 
@@ -106,7 +285,12 @@ void LoggerEmailPlugin::Flush(bool stillRunning, bool force)
 {
     m_cs.lock();
 
-    if (m_queue->empty() || (!force && (int)m_queue->size() < m_maxLogs && (int)(SteadyTime() - m_queueTimestamp) < m_maxDelay * 1000))
+    // send the email early if the logger memory budget is under pressure or an urgent log has waited long enough, even if neither
+    // maxLogs nor maxDelay have been reached
+    const bool underPressure = m_memoryBudget && m_memoryBudget->IsUnderPressure();
+    const bool urgent = m_urgentTimestamp != 0 && (int)(SteadyTime() - m_urgentTimestamp) >= m_urgentDelay;
+    if (m_queue->IsEmpty() || (!force && !underPressure && !urgent && (int)m_queue->GetRecordCount() < m_maxLogs &&
+                             (int)(SteadyTime() - m_queueTimestamp) < m_maxDelay * 1000))
     {
         // nothing to flush yet, let's unlock and return
         m_cs.unlock();
@@ -114,48 +298,80 @@ void LoggerEmailPlugin::Flush(bool stillRunning, bool force)
     }
 
     auto queueCopy = std::move(m_queue);
-    m_queue = std::make_unique<queue<string>>();  // create a new queue for future logs
+    m_queue = std::make_unique<LogDigest>(m_digest);  // create a new queue for future logs
+    const size_t queueMemory = m_queueMemory;         // the email releases it, once it's delivered (see BudgetedEmailBody)
+    m_queueMemory = 0;
+    m_urgentTimestamp = 0;
+    const string subject = m_subject;  // these may change on reload, once we unlock
+    const vector<string> recipients = m_recipients;
     // we're done with m_emailQueue, it is now freshly initialized
     // let's unlock the logger and then take care of the email sending
     m_cs.unlock();
 
-    // We need to start a new thread to send the email, because it might take a while and we don't want to block the logger thread (even
-    // when shutting down - we need to shut down reasonably fast, regardless of the email delivery).
-    // NOTE: it is dangerous to detach a thread that depends on the logger, because the logger might be destroyed before the thread
-    // finishes. However, since SendSimpleEmail only needs the class data to prepare the email (which is done at the beginning), the chances
-    // of a crash are low.
-    // TODO: (not really urgent) make the email delivery independent of basically everything, so that it can be safely detached.
-    auto smtpThread = thread(&LoggerEmailPlugin::SendEmail, this, std::move(queueCopy), stillRunning);
-    if (stillRunning)
-    {
-        // fire & forget: assume that we'll be running long enough for the SMTP delivery to complete
-        smtpThread.detach();
-        if (force)
+    // prepare the email content; large batches are compressed as they're written, and only a summary goes into the body
+    shared_ptr<const IEmailBody> body;
+    vector<EmailAttachment> attachments;
+    if (m_attachmentThreshold > 0 && queueCopy->GetTextLength() >= m_attachmentThreshold)
+    {
+        try
+        {
+            GzipCompressor compressor;
+            queueCopy->WriteText([&](string_view piece) { compressor.Write(piece); });
+            auto data = compressor.Finish();
+            const string name = GetAttachmentName();
+            body = make_shared<StringEmailBody>(GetSummary(*queueCopy, name, data.length()));
+            attachments.push_back({name, "application/gzip", std::move(data)});
+        }
+        catch (const std::exception& e)
         {
-            // forced flush might mean that the software is shutting down. In such cases, a small delay might
-            // prevent crash due to detaching thread too early (see the comment above).
-            SLEEP(100);
+            LOGSTR(Error) << "section=" << m_section << ": failed to compress the logs, sending them as text: " << e.what();
+            attachments.clear();
         }
     }
-    else
+    if (attachments.empty())
     {
-        // we're shutting down, so we can't simply forget about the SMTP delivery because it would most likely get canceled if we simply
-        // detach the thread. So, instead of detaching the thread, we try to join it in a reasonable time.
-        // NOTE that we can't afford the usual long(ish) delivery timeout, but a shorter one. The SendMail method takes care of overriding
-        // the default timeout when shutting down.
-        smtpThread.join();
+        // the digest itself becomes the body
+        body = make_shared<LogDigestEmailBody>(std::move(queueCopy));
     }
+    if (m_memoryBudget)
+    {
+        body = make_shared<BudgetedEmailBody>(std::move(body), m_memoryBudget, queueMemory);
+    }
+
+    // The delivery takes place in the pool, because it might take a while and we don't want to block the logger thread. When we're
+    // shutting down, we use a shorter timeout; we don't wait for the delivery here, the pool does it once for all plugins, when
+    // it's destroyed (see EmailDeliveryPool::Shutdown).
+    m_deliveryPool->Submit(this, m_emailSender, subject, recipients, std::move(body), stillRunning ? 0 : m_timeoutOnShutdown,
+                           std::move(attachments));
 }
 
-void LoggerEmailPlugin::SendEmail(unique_ptr<queue<string>> emailQueue, bool stillRunning)
+string LoggerEmailPlugin::GetSummary(const LogDigest& logs, const string& attachmentName, size_t compressedSize) const
 {
-    // prepare the email content
-    std::ostringstream oss;
-    while (!emailQueue->empty())
+    constexpr size_t summaryLines = 20;
+
+    ostringstream summary;
+    summary << logs.GetRecordCount() << " logs";
+    if (logs.GetLineCount() != logs.GetRecordCount())
+    {
+        summary << " (" << logs.GetLineCount() << " distinct)";
+    }
+    const char* separator = ": ";
+    for (int level = Fatal; level >= Verbose; level--)
+    {
+        if (logs.GetRecordCount((LogLevel)level) > 0)
+        {
+            summary << separator << logs.GetRecordCount((LogLevel)level) << " " << GetLogLevelName((LogLevel)level);
+            separator = ", ";
+        }
+    }
+    summary << "\n\nThe complete logs are attached (" << attachmentName << ", " << compressedSize / 1024 << " KB, compressed from "
+            << logs.GetTextLength() / 1024 << " KB).";
+    if (logs.GetLineCount() > summaryLines)
     {
-        oss << emailQueue->front();
-        emailQueue->pop();
+        summary << " The first " << summaryLines << " lines:";
     }
+    summary << "\n\n";
+    logs.WriteText([&](string_view piece) { summary << piece; }, summaryLines);
 
-    m_emailSender.SendSimpleEmail(m_subject, oss.str(), m_recipients, "", stillRunning ? 0 : m_timeoutOnShutdown);
+    return summary.str();
 }
@@ -0,0 +1,185 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#include <Logger/LoggerStatistics.h>
+#include <Logger/Logger.h>
+
+using namespace std;
+
+LoggerStatistics::LoggerStatistics() = default;
+
+size_t LoggerStatistics::AddSink(const string& name)
+{
+    m_sinks.push_back(make_unique<SinkCounters>());
+    m_sinks.back()->name = name;
+    return m_sinks.size() - 1;
+}
+
+LoggerStatistics::Shard& LoggerStatistics::GetThreadShard(array<Shard, m_shardCount>& shards) noexcept
+{
+    // assign shards to threads in a round-robin fashion, the first time each thread logs something
+    static atomic<size_t> nextShard = 0;
+    thread_local const size_t shardIndex = nextShard.fetch_add(1, memory_order_relaxed) % m_shardCount;
+    return shards[shardIndex];
+}
+
+void LoggerStatistics::CountRecord(size_t level, size_t bytes) noexcept
+{
+    if (level < LOG_LEVEL_COUNT)
+    {
+        auto& shard = GetThreadShard(m_shards);
+        shard.records[level].fetch_add(1, memory_order_relaxed);
+        shard.bytes[level].fetch_add(bytes, memory_order_relaxed);
+    }
+}
+
+void LoggerStatistics::CountDrop(size_t level) noexcept
+{
+    if (level < LOG_LEVEL_COUNT)
+    {
+        GetThreadShard(m_shards).drops[level].fetch_add(1, memory_order_relaxed);
+    }
+}
+
+void LoggerStatistics::CountSinkRecords(size_t sink, uint64_t records, uint64_t bytes) noexcept
+{
+    if (sink < m_sinks.size())
+    {
+        m_sinks[sink]->records.fetch_add(records, memory_order_relaxed);
+        m_sinks[sink]->bytes.fetch_add(bytes, memory_order_relaxed);
+    }
+}
+
+void LoggerStatistics::CountSinkDrops(size_t sink, uint64_t drops) noexcept
+{
+    if (sink < m_sinks.size())
+    {
+        m_sinks[sink]->drops.fetch_add(drops, memory_order_relaxed);
+    }
+}
+
+void LoggerStatistics::CountSinkFlush(size_t sink, uint64_t microseconds) noexcept
+{
+    if (sink < m_sinks.size())
+    {
+        // find the decimal histogram bucket, starting with < 1 ms
+        size_t bucket = 0;
+        for (uint64_t limit = 1000; bucket < LOG_FLUSH_HISTOGRAM_BUCKETS - 1 && microseconds >= limit; limit *= 10)
+        {
+            bucket++;
+        }
+
+        m_sinks[sink]->flushCount.fetch_add(1, memory_order_relaxed);
+        m_sinks[sink]->flushDurationHistogram[bucket].fetch_add(1, memory_order_relaxed);
+    }
+}
+
+LogStatisticsSnapshot LoggerStatistics::GetSnapshot() const
+{
+    LogStatisticsSnapshot snapshot;
+
+    for (const auto& shard : m_shards)
+    {
+        for (size_t level = 0; level < LOG_LEVEL_COUNT; level++)
+        {
+            snapshot.records[level] += shard.records[level].load(memory_order_relaxed);
+            snapshot.bytes[level] += shard.bytes[level].load(memory_order_relaxed);
+            snapshot.drops[level] += shard.drops[level].load(memory_order_relaxed);
+        }
+    }
+
+    snapshot.sinks.reserve(m_sinks.size());
+    for (const auto& sink : m_sinks)
+    {
+        LogSinkStatistics sinkStatistics;
+        sinkStatistics.name = sink->name;
+        sinkStatistics.records = sink->records.load(memory_order_relaxed);
+        sinkStatistics.bytes = sink->bytes.load(memory_order_relaxed);
+        sinkStatistics.drops = sink->drops.load(memory_order_relaxed);
+        sinkStatistics.flushCount = sink->flushCount.load(memory_order_relaxed);
+        for (size_t i = 0; i < LOG_FLUSH_HISTOGRAM_BUCKETS; i++)
+        {
+            sinkStatistics.flushDurationHistogram[i] = sink->flushDurationHistogram[i].load(memory_order_relaxed);
+        }
+        snapshot.sinks.push_back(std::move(sinkStatistics));
+    }
+
+    return snapshot;
+}
+
+string LogStatisticsSnapshot::SummaryText() const
+{
+    static const char* const bucketNames[LOG_FLUSH_HISTOGRAM_BUCKETS] = {"<1ms", "<10ms", "<100ms", "<1s", "<10s", ">=10s"};
+
+    ostringstream oss;
+    oss << "records";
+    for (size_t level = 0; level < LOG_LEVEL_COUNT; level++)
+    {
+        oss << " " << GetLogLevelName((LogLevel)level) << "=" << records[level];
+        if (drops[level] > 0)
+        {
+            oss << " (" << drops[level] << " dropped)";
+        }
+    }
+
+    uint64_t totalBytes = 0;
+    for (const auto b : bytes)
+    {
+        totalBytes += b;
+    }
+    oss << ", " << totalBytes << " bytes, queue memory " << memoryUsage << " (peak " << peakMemoryUsage << ")";
+
+    for (const auto& sink : sinks)
+    {
+        oss << "; " << sink.name << ": " << sink.records << " records, " << sink.bytes << " bytes";
+        if (sink.drops > 0)
+        {
+            oss << ", " << sink.drops << " dropped";
+        }
+        if (sink.flushCount > 0)
+        {
+            oss << ", " << sink.flushCount << " flushes (";
+            const char* separator = "";
+            for (size_t i = 0; i < LOG_FLUSH_HISTOGRAM_BUCKETS; i++)
+            {
+                if (sink.flushDurationHistogram[i] > 0)
+                {
+                    oss << separator << bucketNames[i] << " " << sink.flushDurationHistogram[i];
+                    separator = ", ";
+                }
+            }
+            oss << ")";
+        }
+        if (!sink.status.empty())
+        {
+            oss << ", " << sink.status;
+        }
+    }
+
+    return oss.str();
+}
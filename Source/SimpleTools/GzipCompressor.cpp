@@ -0,0 +1,98 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#include <SimpleTools/GzipCompressor.h>
+
+#include <stdexcept>
+#include <zlib.h>
+
+using namespace std;
+
+GzipCompressor::GzipCompressor(int level) : m_stream(nullptr), m_inputSize(0)
+{
+    auto stream = new z_stream{};
+    // 15 bits of window, +16 for the gzip header and trailer instead of the zlib ones
+    if (deflateInit2(stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        delete stream;
+        throw runtime_error("deflateInit2 failed");
+    }
+    m_stream = stream;
+}
+
+GzipCompressor::~GzipCompressor()
+{
+    if (m_stream)
+    {
+        auto stream = static_cast<z_stream*>(m_stream);
+        deflateEnd(stream);
+        delete stream;
+    }
+}
+
+void GzipCompressor::Deflate(string_view data, int flush)
+{
+    auto stream = static_cast<z_stream*>(m_stream);
+    stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream->avail_in = TOUINT(data.length());
+
+    // grow the output as needed; logs usually compress well, so a fraction of the input is a good first guess
+    do
+    {
+        const size_t used = m_output.length();
+        const size_t available = max<size_t>(data.length() / 4, 16384);
+        m_output.resize(used + available);
+        stream->next_out = reinterpret_cast<Bytef*>(m_output.data() + used);
+        stream->avail_out = TOUINT(available);
+        deflate(stream, flush);
+        m_output.resize(used + available - stream->avail_out);
+    } while (stream->avail_out == 0 || stream->avail_in > 0);
+}
+
+void GzipCompressor::Write(string_view data)
+{
+    if (!m_stream)
+    {
+        throw logic_error("GzipCompressor::Write called after Finish");
+    }
+    m_inputSize += data.length();
+    Deflate(data, Z_NO_FLUSH);
+}
+
+string GzipCompressor::Finish()
+{
+    if (m_stream)
+    {
+        Deflate({}, Z_FINISH);
+        auto stream = static_cast<z_stream*>(m_stream);
+        deflateEnd(stream);
+        delete stream;
+        m_stream = nullptr;
+    }
+    return std::move(m_output);
+}
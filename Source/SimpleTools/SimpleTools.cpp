@@ -29,6 +29,9 @@
 #ifdef _WIN32
 #include <windows.h>
 #else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <climits>
 #endif
@@ -70,7 +73,95 @@ string LoadTextFile(const filesystem::path& filePath)
     return content;
 }
 
-void GetCurrentLocalTime(struct tm& localTime, int& milliseconds) noexcept
+MemoryMappedFile::MemoryMappedFile() noexcept : m_data(nullptr), m_size(0) {}
+
+MemoryMappedFile::~MemoryMappedFile() { Close(); }
+
+bool MemoryMappedFile::Open(const filesystem::path& filePath)
+{
+    Close();
+
+    // the file and mapping handles are not needed once the view exists, the view keeps the mapping alive
+#ifdef _WIN32
+    const HANDLE file = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    if (size.QuadPart > 0)
+    {
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+        {
+            m_data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            SAFE_CLOSE_HANDLE(mapping);
+        }
+        if (!m_data)
+        {
+            CloseHandle(file);
+            return false;
+        }
+        m_size = TOSIZE(size.QuadPart);
+    }
+
+    CloseHandle(file);
+#else
+    const int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st = {};
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    if (st.st_size > 0)
+    {
+        void* data = mmap(nullptr, TOSIZE(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            close(fd);
+            return false;
+        }
+        madvise(data, TOSIZE(st.st_size), MADV_SEQUENTIAL);
+        m_data = static_cast<const char*>(data);
+        m_size = TOSIZE(st.st_size);
+    }
+
+    close(fd);
+#endif
+
+    return true;
+}
+
+void MemoryMappedFile::Close() noexcept
+{
+    if (m_data)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+#else
+        munmap(const_cast<char*>(m_data), m_size);
+#endif
+    }
+    m_data = nullptr;
+    m_size = 0;
+}
+
+std::chrono::system_clock::time_point GetCurrentLocalTime(struct tm& localTime, int& milliseconds) noexcept
 {
     // Get the current time as a time_point
     const auto now = std::chrono::system_clock::now();
@@ -86,6 +177,7 @@ void GetCurrentLocalTime(struct tm& localTime, int& milliseconds) noexcept
     // localTime = std::localtime(&now_time);
     // Extract milliseconds from the current time_point
     milliseconds = TOINT((std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000).count());
+    return now;
 }
 
 uint64_t SteadyTime() noexcept
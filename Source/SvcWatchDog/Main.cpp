@@ -38,6 +38,43 @@
 
 using namespace std;
 
+namespace
+{
+// the sections the service reads; with the configuration cache, only these are loaded
+const vector<string> serviceSections = {"svcWatchDog", "log", "cryptoTools", "smtp"};
+
+// Loads the configuration file. With svcWatchDog.configCache, only the service sections are loaded and kept in a binary cache next
+// to the file (see JsonConfig::SetCacheFile), so on the next start a large file is only hashed, not parsed. The setting can only be
+// read once the file is loaded, so an existing cache is used right away, and the cache is created or removed afterwards.
+void LoadConfiguration(JsonConfig& cfg, const filesystem::path& cfgPath)
+{
+    const auto cachePath = filesystem::path(cfgPath).concat(".cache");
+    error_code ec;
+    const bool cached = filesystem::is_regular_file(cachePath, ec);
+    if (cached)
+    {
+        cfg.SetCacheFile(cachePath);
+        cfg.Load(cfgPath, serviceSections);
+    }
+    else
+    {
+        cfg.Load(cfgPath);
+    }
+
+    const bool useCache = cfg.GetBool("svcWatchDog", "configCache", false);
+    if (cached && !useCache)
+    {
+        filesystem::remove(cachePath, ec);
+    }
+    else if (!cached && useCache)
+    {
+        // load the service sections once more, like on the next start, which also writes the cache
+        cfg.SetCacheFile(cachePath);
+        cfg.Load(cfgPath, serviceSections);
+    }
+}
+}  // namespace
+
 int main(int argc, char* argv[])
 {
     // NOTE: this seems to be far better option than _CrtDumpMemoryLeaks(), because it checks the memory leaks later in the
@@ -65,9 +102,11 @@ int main(int argc, char* argv[])
 
         JsonConfig cfg;
         JsonConfig::SetInstance(&cfg);
+        // environment variables like MyService__log__minConsoleLevel override the configuration files
+        cfg.SetEnvironmentPrefix(exePath.stem().string() + "__");
         try
         {
-            cfg.Load(cfgPath);
+            LoadConfiguration(cfg, cfgPath);
         }
         catch (const std::exception& e)
         {
@@ -94,7 +133,22 @@ int main(int argc, char* argv[])
         LoggerEmailPlugin::ConfigureAll(Cfg, Lg);
 
         // now we can configure the service, because the logger is ready
-        cService.Configure();
+        try
+        {
+            cService.Configure();
+        }
+        catch (const std::exception& e)
+        {
+            LOGSTR(Fatal) << "unable to configure the service: " << e.what();
+            cerr << "Unable to use configuration file " << cfgPath.string() << "." << endl << e.what() << endl;
+            return -2;
+        }
+
+        // reload the configuration file whenever it changes, if requested
+        if (Cfg.GetBool("svcWatchDog", "reloadConfig", false))
+        {
+            cfg.StartWatching();
+        }
 
         // Parse for standard arguments (install, uninstall, version etc.)
         if (!cService.ParseStandardArgs(argc, argv))
@@ -108,6 +162,7 @@ int main(int argc, char* argv[])
 
         // When we get here, the service has been stopped
         returnCode = cService.m_serviceStatus.dwWin32ExitCode;
+        cfg.StopWatching();
         LOGSTR() << "exiting with result code " << returnCode;
 
         // cryptoTools.SelfTest();
@@ -36,6 +36,7 @@
 
 #include <SvcWatchDog/SvcWatchDog.h>
 #include <JsonConfig/JsonConfig.h>
+#include <JsonConfig/ConfigSchema.h>
 #include <Logger/Logger.h>
 
 #include <curl/curl.h>
@@ -52,7 +53,35 @@ SvcWatchDog* SvcWatchDog::m_instance = nullptr;
 // using three of them - major.minor.patch)
 #define SVCWATCHDOG_VERSION "1.1.0"
 
-SvcWatchDog::SvcWatchDog() noexcept : m_section("svcWatchDog")
+namespace
+{
+const ConfigSchema<SvcWatchDogSettings>& GetSettingsSchema()
+{
+    // delays and timeouts may have a unit suffix (for example "5s"), but they can't be longer than a day
+    constexpr int maxTime = 24 * 3600 * 1000;
+    constexpr auto ms = ConfigUnit::Milliseconds;
+
+    // workDir is needed before the logger is configured, reloadConfig before the configuration is watched and configCache right
+    // after it is loaded, so they're read directly from the configuration
+    static const auto schema = ConfigSchema<SvcWatchDogSettings>()
+                                   .ExternalField("workDir")
+                                   .Field("args", &SvcWatchDogSettings::args)
+                                   .Field("usePath", &SvcWatchDogSettings::usePath, false)
+                                   .Field("autoStart", &SvcWatchDogSettings::autoStart, false)
+                                   .Field("loadOrderGroup", &SvcWatchDogSettings::loadOrderGroup)
+                                   .Field("restartDelay", &SvcWatchDogSettings::restartDelay, 5000, 0, maxTime, ms)
+                                   .Field("shutdownTime", &SvcWatchDogSettings::shutdownTime, 10000, 0, maxTime, ms)
+                                   .Field("watchdogTimeout", &SvcWatchDogSettings::watchdogTimeout, -1, -1, maxTime, ms)
+                                   .ExternalField("reloadConfig")
+                                   .ExternalField("configCache");
+    return schema;
+}
+}  // namespace
+
+SvcWatchDog::SvcWatchDog() noexcept
+    : m_section("svcWatchDog"),
+      m_settings(make_shared<const SvcWatchDogSettings>(GetSettingsSchema().GetDefaults())),
+      m_settingsSubscription(0)
 {
     // copy the address of the current object so we can access it from
     // the static member callback functions.
@@ -104,11 +133,17 @@ void SvcWatchDog::Configure()
     m_serviceStatus.dwCheckPoint = 0;
     m_serviceStatus.dwWaitHint = 0;
 
-    const bool usePath = Cfg.GetBool(m_section, "usePath", false);
+    // the settings are parsed now and again whenever the section changes; if they're invalid now, this throws, because the
+    // application can't be started without them
+    m_settingsSubscription = Cfg.Subscribe(
+        m_section, [this](const json* oldValue, const json* newValue) { ApplySettings(oldValue, newValue); }, true);
+
+    const auto settings = GetSettings();
+    const bool usePath = settings->usePath;
     LOGSTR() << "usePath=" << BOOL2STR(usePath);
 
     // read all child process arguments, starting with the actual executable path (or at least file name)
-    auto argv = Cfg.GetStringVector(m_section, "args");
+    auto argv = settings->args;
 
     int i = 0;
     for (const auto& arg : argv)
@@ -158,6 +193,47 @@ void SvcWatchDog::Configure()
     m_argv[i] = nullptr;  // terminate the array of arguments
 }
 
+shared_ptr<const SvcWatchDogSettings> SvcWatchDog::GetSettings() { return m_settings.load(); }
+
+void SvcWatchDog::ApplySettings(const json* oldValue, const json* newValue)
+{
+    const auto previousSettings = GetSettings();
+    shared_ptr<const SvcWatchDogSettings> settings;
+    try
+    {
+        settings = make_shared<const SvcWatchDogSettings>(GetSettingsSchema().BindSection(newValue, m_section));
+    }
+    catch (const exception& e)
+    {
+        if (!oldValue)
+        {
+            throw;
+        }
+        LOGSTR(Error) << e.what() << ", keeping the previous settings";
+        return;
+    }
+
+    m_settings.store(settings);
+    LOGSTR(Information) << m_section << " settings applied: restartDelay=" << settings->restartDelay
+                        << ", shutdownTime=" << settings->shutdownTime << ", watchdogTimeout=" << settings->watchdogTimeout;
+    if (!oldValue)
+    {
+        return;
+    }
+
+    // the delays and the watchdog timeout are read whenever they're needed, but the rest only affects the next start of the child
+    // process or the next installation of the service
+    const auto restartKeys = JsonConfig::GetChangedKeys(oldValue, newValue, {"restartDelay", "shutdownTime", "watchdogTimeout"});
+    if (!restartKeys.empty())
+    {
+        LOGSTR(Warning) << "changes of " << JoinStrings(restartKeys, ", ") << " take effect after the service is restarted";
+    }
+    if (previousSettings->watchdogTimeout <= 0 && settings->watchdogTimeout > 0 && m_watchdogSocket == INVALID_SOCKET)
+    {
+        LOGSTR(Warning) << "the UDP watchdog can only be enabled by restarting the service";
+    }
+}
+
 // Default command line argument parsing
 // Returns true if it found an arg it recognized, false if not
 // Note: processing some arguments causes output to stdout or stderr to be generated.
@@ -239,6 +315,11 @@ void SvcWatchDog::CdToWorkingDir()
 
 SvcWatchDog::~SvcWatchDog()
 {
+    if (m_settingsSubscription)
+    {
+        Cfg.Unsubscribe(m_settingsSubscription);
+    }
+
     LOGSTR() << "shutting down";
     for (int i = 0; i < SVCWATCHDOG_MAX_ARGV && m_argv[i]; i++)
     {
@@ -357,11 +438,9 @@ void SvcWatchDog::Run()
 
     CdToWorkingDir();
 
-    const int watchdogTimeout = Cfg.GetNumber(m_section, "watchdogTimeout", -1);
-    LOGSTR(Information) << "watchdogTimeout=" << watchdogTimeout;
-
-    // if UDP watchdog is configured, start listening on a random port
-    if (watchdogTimeout > 0)
+    // if UDP watchdog is configured, start listening on a random port; it can't be enabled later, but its timeout can change (and it
+    // can be disabled) while the child process is running
+    if (GetSettings()->watchdogTimeout > 0)
     {
         // not much of a secret, but it should do
         m_watchdogSecret = to_string(rand()) + to_string(SteadyTime());
@@ -415,7 +494,7 @@ void SvcWatchDog::Run()
         DWORD exitCode = STILL_ACTIVE;
         BOOL exitCodeValid = FALSE;
         uint64_t now = SteadyTime();
-        uint64_t nextPing = now + watchdogTimeout;
+        uint64_t nextPing = 0;  // set by the first check, and again whenever the watchdog is enabled
 
         while (processHandle >= 0 && exitCode == STILL_ACTIVE && (m_killTime == 0 || m_killTime > now))
         {
@@ -435,8 +514,18 @@ void SvcWatchDog::Run()
 
             now = SteadyTime();
 
-            if (m_watchdogSocket != INVALID_SOCKET && m_killTime == 0)
+            const int watchdogTimeout = GetSettings()->watchdogTimeout;
+            if (watchdogTimeout <= 0)
+            {
+                nextPing = 0;
+            }
+            else if (m_watchdogSocket != INVALID_SOCKET && m_killTime == 0)
             {
+                if (nextPing == 0)
+                {
+                    nextPing = now + watchdogTimeout;
+                }
+
                 while (ReceiveUdpPing())
                 {
                     // the process is alive and well
@@ -481,7 +570,7 @@ void SvcWatchDog::Run()
 
         if (m_isRunning)
         {
-            const int restartDelay = Cfg.GetNumber(m_section, "restartDelay", 5000);
+            const int restartDelay = GetSettings()->restartDelay;
             LOGSTR() << "waiting " << restartDelay << " ms before restarting";
             WaitForSingleObject(m_loopTriggerEvent, restartDelay);
         }
@@ -521,10 +610,11 @@ bool SvcWatchDog::Install()
                                           SC_MANAGER_ALL_ACCESS);  // full access
     if (!scmHandle) return false;
 
-    string loadOrderGroup = Cfg.GetString(m_section, "loadOrderGroup", "");
+    const auto settings = GetSettings();
+    const string loadOrderGroup = settings->loadOrderGroup;
     LOGSTR(Information) << "loadOrderGroup=" << loadOrderGroup;
 
-    const bool autoStart = Cfg.GetBool(m_section, "autoStart", false);
+    const bool autoStart = settings->autoStart;
     LOGSTR(Information) << "autoStart=" << BOOL2STR(autoStart);
 
     // Create the service
@@ -699,7 +789,7 @@ void SvcWatchDog::Handler(DWORD dwOpcode)
 
 void SvcWatchDog::InitiateProcessShutdown()
 {
-    const uint64_t shutdownTime = Cfg.GetNumber(m_section, "shutdownTime", 10000);
+    const uint64_t shutdownTime = GetSettings()->shutdownTime;
     LOGSTR(Information) << "signalling the process and setting timeout to now + " << shutdownTime << " ms";
 
     // signal the child process, so it can shut down gracefully
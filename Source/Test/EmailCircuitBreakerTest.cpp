@@ -0,0 +1,105 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#include <Logger/Logger.h>
+#include <Email/EmailCircuitBreaker.h>
+#include <Test/EmailCircuitBreakerTest.h>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+void EmailCircuitBreakerTest()
+{
+    // the delay is short, so the test doesn't take long, but long enough not to pass while the test is running
+    constexpr int delay = 200;
+    EmailCircuitBreaker breaker;
+    breaker.Configure(3, delay);
+    uint64_t probe = 1;
+    uint64_t retryTime = 0;
+
+    // the circuit only opens after threshold consecutive failures
+    LOGASSERT(breaker.TryAcquire(probe) && probe == 0);
+    breaker.ReportResult(false, 0);
+    breaker.ReportResult(false, 0);
+    breaker.ReportResult(true, 0);
+    breaker.ReportResult(false, 0);
+    breaker.ReportResult(false, 0);
+    LOGASSERT(breaker.GetState() == EmailCircuitBreaker::Closed);
+    breaker.ReportResult(false, 0);
+    LOGASSERT(breaker.GetState() == EmailCircuitBreaker::Open);
+    LOGASSERT(!breaker.TryAcquire(probe) && probe == 0);
+    LOGASSERT(breaker.IsBlocked(retryTime) && retryTime > SteadyTime());
+
+    // after the delay, only one probe is let through
+    SLEEP(delay + 50);
+    LOGASSERT(breaker.GetState() == EmailCircuitBreaker::HalfOpen);
+    LOGASSERT(!breaker.IsBlocked(retryTime));
+    uint64_t firstProbe = 0;
+    LOGASSERT(breaker.TryAcquire(firstProbe) && firstProbe != 0);
+    LOGASSERT(!breaker.TryAcquire(probe) && probe == 0);
+    LOGASSERT(breaker.IsBlocked(retryTime));
+
+    // the deliveries, started before the circuit opened, don't count while half-open
+    breaker.ReportResult(true, 0);
+    breaker.ReportResult(false, 0);
+    LOGASSERT(breaker.GetState() == EmailCircuitBreaker::HalfOpen);
+
+    // a probe which doesn't report back is replaced after the delay, and its late result is ignored
+    SLEEP(delay + 50);
+    uint64_t secondProbe = 0;
+    LOGASSERT(breaker.TryAcquire(secondProbe) && secondProbe != 0 && secondProbe != firstProbe);
+    breaker.ReportResult(true, firstProbe);
+    LOGASSERT(breaker.GetState() == EmailCircuitBreaker::HalfOpen);
+
+    // a failed probe opens the circuit again (not counted as a new opening), a successful one closes it
+    breaker.ReportResult(false, secondProbe);
+    LOGASSERT(breaker.GetState() == EmailCircuitBreaker::Open);
+    SLEEP(delay + 50);
+    LOGASSERT(breaker.TryAcquire(probe) && probe != 0);
+    breaker.ReportResult(true, probe);
+    LOGASSERT(breaker.GetState() == EmailCircuitBreaker::Closed);
+    LOGASSERT(breaker.TryAcquire(probe) && probe == 0);
+    LOGASSERT(breaker.TryAcquire(probe) && probe == 0);
+    LOGASSERT(breaker.GetStatusText() == "circuit closed, 0 consecutive failures, 6 failures, 2 deliveries, opened 1 times");
+
+    // threshold 0 disables the circuit breaker, also an open one
+    breaker.ReportResult(false, 0);
+    breaker.ReportResult(false, 0);
+    breaker.ReportResult(false, 0);
+    LOGASSERT(breaker.GetState() == EmailCircuitBreaker::Open);
+    breaker.Configure(0, delay);
+    LOGASSERT(breaker.GetState() == EmailCircuitBreaker::Closed);
+    for (int i = 0; i < 10; i++)
+    {
+        breaker.ReportResult(false, 0);
+    }
+    LOGASSERT(breaker.TryAcquire(probe) && probe == 0);
+
+    LOGSTR() << "EmailCircuitBreaker test completed";
+}
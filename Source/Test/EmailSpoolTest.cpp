@@ -0,0 +1,176 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#include <Logger/Logger.h>
+#include <Email/EmailSpool.h>
+#include <Test/EmailSpoolTest.h>
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+using namespace std;
+
+namespace
+{
+filesystem::path GetOnlySpoolFile(const filesystem::path& directory)
+{
+    filesystem::path result;
+    size_t count = 0;
+    error_code ec;
+    for (const auto& item : filesystem::directory_iterator(directory, ec))
+    {
+        result = item.path();
+        count++;
+    }
+    LOGASSERT(count == 1);
+    return result;
+}
+}  // namespace
+
+void EmailSpoolTest()
+{
+    error_code ec;
+    const auto directory = filesystem::temp_directory_path(ec) / "SvcWatchDogEmailSpoolTest";
+    filesystem::remove_all(directory, ec);
+
+    const auto anyOwner = [](const string&) { return true; };
+    const vector<shared_ptr<const IEmailBody>> body = {make_shared<StringEmailBody>("first part, "),
+                                                       make_shared<StringEmailBody>("second part")};
+    const vector<EmailAttachment> attachments = {{"logs.txt.gz", "application/gzip", string("\x1f\x8b\0\x01", 4)}};
+
+    // store two emails, then "restart"
+    {
+        EmailSpool spool(directory, 1000000, 1000, 60000);
+        LOGASSERT(spool.Store("owner1", "subject 1", {"a@localhost", "b@localhost"}, body, attachments, 0));
+        LOGASSERT(spool.Store("owner2", "subject 2", {"c@localhost"}, body, {}, 3));
+        LOGASSERT(spool.GetCount() == 2);
+    }
+
+    // the emails left over are due immediately, the oldest first, and come back exactly as they were stored
+    {
+        EmailSpool spool(directory, 1000000, 1000, 60000);
+        LOGASSERT(spool.GetCount() == 2);
+        string owner;
+        const uint64_t sequence = spool.TakeDue(anyOwner, owner);
+        LOGASSERT(sequence != 0 && owner == "owner1");
+
+        string subject;
+        vector<string> recipients;
+        string text;
+        vector<EmailAttachment> loaded;
+        LOGASSERT(spool.Load(sequence, subject, recipients, text, loaded));
+        LOGASSERT(subject == "subject 1");
+        LOGASSERT(recipients == vector<string>({"a@localhost", "b@localhost"}));
+        LOGASSERT(text == "first part, second part");
+        LOGASSERT(loaded.size() == 1 && loaded[0].fileName == attachments[0].fileName &&
+                  loaded[0].contentType == attachments[0].contentType && loaded[0].data == attachments[0].data);
+        spool.Remove(sequence);
+        LOGASSERT(spool.GetCount() == 1);
+    }
+
+    // flip a byte of the remaining email; the header still looks fine, but the checksum doesn't match, so it is removed
+    {
+        const auto path = GetOnlySpoolFile(directory);
+        fstream file(path, ios::binary | ios::in | ios::out);
+        file.seekg(-1, ios::end);
+        const char c = static_cast<char>(file.get() ^ 0x20);
+        file.seekp(-1, ios::end);
+        file.put(c);
+    }
+    {
+        EmailSpool spool(directory, 1000000, 1000, 60000);
+        LOGASSERT(spool.GetCount() == 1);
+        string owner;
+        const uint64_t sequence = spool.TakeDue(anyOwner, owner);
+        LOGASSERT(sequence != 0 && owner == "owner2");
+
+        string subject;
+        vector<string> recipients;
+        string text;
+        vector<EmailAttachment> loaded;
+        LOGSTR() << "there should be a damaged spool file error in the next line";
+        LOGASSERT(!spool.Load(sequence, subject, recipients, text, loaded));
+        LOGASSERT(spool.GetCount() == 0 && spool.GetSize() == 0);
+        LOGASSERT(filesystem::is_empty(directory, ec));
+    }
+
+    // an email of an owner which is gone after the restart; its age is taken from the file, so it expires right away
+    {
+        EmailSpool spool(directory, 1000000, 1000, 60000);
+        LOGASSERT(spool.Store("gone", "orphan", {"a@localhost"}, body, {}, 0));
+    }
+    filesystem::last_write_time(GetOnlySpoolFile(directory), filesystem::file_time_type::clock::now() - chrono::hours(2), ec);
+    LOGASSERT(!ec);
+    {
+        EmailSpool spool(directory, 1000000, 1000, 60000, 3600000);
+        const auto owners = spool.GetOwners();
+        LOGASSERT(owners.size() == 1 && owners.begin()->first == "gone" && owners.begin()->second == 1);
+        LOGASSERT(spool.Expire() == 1);
+        LOGASSERT(spool.GetCount() == 0 && spool.GetSize() == 0);
+        LOGASSERT(filesystem::is_empty(directory, ec));
+
+        // a fresh email doesn't expire yet
+        LOGASSERT(spool.Store("owner1", "fresh", {"a@localhost"}, body, {}, 0));
+        LOGASSERT(spool.Expire() == 0 && spool.GetCount() == 1);
+    }
+
+    // concurrent writers get their own sequence numbers and the size adds up
+    {
+        filesystem::remove_all(directory, ec);
+        EmailSpool spool(directory, 100000000, 1000, 60000);
+        const int numThreads = 8;
+        const int numEmails = 25;
+        vector<thread> threads;
+        for (int i = 0; i < numThreads; i++)
+        {
+            threads.emplace_back(
+                [&spool, &body, i]()
+                {
+                    for (int j = 0; j < numEmails; j++)
+                    {
+                        LOGASSERT(spool.Store("owner" + to_string(i), "subject", {"a@localhost"}, body, {}, 0));
+                    }
+                });
+        }
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        LOGASSERT(spool.GetCount() == numThreads * numEmails);
+        uint64_t size = 0;
+        size_t files = 0;
+        for (const auto& item : filesystem::directory_iterator(directory, ec))
+        {
+            size += item.file_size(ec);
+            files++;
+        }
+        LOGASSERT(files == spool.GetCount() && size == spool.GetSize());
+    }
+
+    filesystem::remove_all(directory, ec);
+}
@@ -0,0 +1,464 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+// Command line tool, which measures the cost of the JsonConfig operations, which are on the startup and the reload paths:
+//   - lookups at different depths, with the section and key given as strings and as pre-parsed ConfigPath handles, and for
+//     comparison, the original lookup, which split the path into a vector of strings and looked each token up twice,
+//   - the string, key and array getters, and their allocation-free ConfigView counterparts,
+//   - conversion of numbers, written as numbers and as decimal, hex, binary, digit-separated and unit-suffixed strings,
+//   - binding of a whole section with ParseSection() and ConfigSchema,
+//   - with -l, loading of generated configuration files of different sizes: read into a string and parsed as a whole (the original
+//     Load), memory mapped, memory mapped with only the sections the service needs, and the same sections from the binary cache.
+// With -j, each result is printed as a JSON object on its own line, for scripts and regression tracking.
+// Build it together with Source/JsonConfig/JsonConfig.cpp, Source/SimpleTools/SimpleTools.cpp and the logger sources (on Windows,
+// JsonConfigBenchmark.vcxproj does it), on Linux for example:
+//   g++ -std=c++20 -O2 -DLINUX -IInclude Source/Test/JsonConfigBenchmarkMain.cpp Source/JsonConfig/JsonConfig.cpp
+//       Source/SimpleTools/SimpleTools.cpp Source/Logger/Logger.cpp Source/Logger/LoggerStatistics.cpp
+//       Source/Logger/LogFileTools.cpp -lz -lpthread -o JsonConfigBenchmark
+
+#include <JsonConfig/JsonConfig.h>
+#include <JsonConfig/ConfigSchema.h>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <climits>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// print the results as JSON lines instead of a table
+bool jsonOutput = false;
+
+void PrintUsage(const char* programName)
+{
+    cout << "JsonConfig Benchmark - measures the cost of configuration lookups, getters, number parsing, section binding and loading\n\n";
+    cout << "Usage: " << programName << " [-j] [iterations]\n";
+    cout << "       " << programName << " [-j] -l [megabytes...]\n\n";
+    cout << "Parameters:\n";
+    cout << "  -j          Print each result as a JSON object on its own line\n";
+    cout << "  iterations  Number of operations per measurement (default 1000000)\n";
+    cout << "  -l          Measure loading of generated configuration files of the given sizes instead (default 0 1 10 50 MB,\n";
+    cout << "              0 is the example configuration without any generated data)\n\n";
+    cout << "Example:\n";
+    cout << "  " << programName << " 5000000\n";
+    cout << "  " << programName << " -j -l 1 50 > results.jsonl\n\n";
+}
+
+void PrintSuite(const string& suite)
+{
+    if (!jsonOutput)
+    {
+        cout << suite << ":\n";
+    }
+}
+
+void PrintResult(const string& suite, const string& name, double value, const string& unit, size_t iterations, size_t checksum)
+{
+    if (jsonOutput)
+    {
+        cout << json{{"suite", suite}, {"name", name}, {"value", value}, {"unit", unit}, {"iterations", iterations}, {"checksum", checksum}}
+                    .dump()
+             << endl;
+        return;
+    }
+
+    cout << "  " << left << setw(48) << name << right << setw(10) << fixed << setprecision(1) << value << " " << unit
+         << "   (checksum " << checksum << ")\n";
+}
+
+json CreateConfiguration()
+{
+    // modeled after the example configuration file, with a few more sections to make the objects realistically large
+    json cfg = json::parse(R"({
+        "log": {
+            "minConsoleLevel": 1, "minFileLevel": 0, "filePath": "log/SvcWatchDog.log", "maxFileSize": 10000000,
+            "maxOldFiles": 10, "maxWriteDelay": 500, "logThreadId": false,
+            "email": {
+                "maxConcurrentDeliveries": 8, "spoolDir": "spool",
+                "someRecipients": {
+                    "minLogLevel": 2, "recipients": ["janet@example.com", "brad@example.com"], "emailSection": "smtp.gmx",
+                    "maxDelay": 10, "maxLogs": 2000, "timeoutOnShutdown": 2000
+                }
+            }
+        },
+        "svcWatchDog": { "args": ["app.exe", "-v"], "workDir": "", "restartDelay": "5s", "shutdownTime": 10000, "watchdogTimeout": 60 },
+        "smtp": { "gmx": { "smtpServerUrl": "smtp://mail.gmx.net:587", "sslFlag": 3, "timeout": 10000 } }
+    })");
+    for (int i = 0; i < 20; i++)
+    {
+        cfg["section" + to_string(i)] = {{"value", i}};
+        cfg["log"]["option" + to_string(i)] = i;
+        cfg["log"]["email"]["plugin" + to_string(i)] = {{"maxDelay", i}};
+    }
+    return cfg;
+}
+
+// The original JsonConfig::FindKey, kept here as the reference.
+json* SplitFindKey(json& root, const string& path, const string& key)
+{
+    auto tokens = Split(path, '.');
+    if (!key.empty())
+    {
+        tokens.push_back(key);
+    }
+
+    json* current = &root;
+    for (const auto& token : tokens)
+    {
+        if (current->contains(token))
+        {
+            current = &(*current)[token];
+        }
+        else
+        {
+            return nullptr;
+        }
+    }
+
+    return current;
+}
+
+// Runs the operation the given number of times and prints the average time in nanoseconds.
+void Measure(const string& suite, const string& name, size_t iterations, const function<size_t()>& operation)
+{
+    size_t checksum = 0;
+    const auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+    {
+        checksum += operation();
+    }
+    const auto elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+
+    PrintResult(suite, name, elapsed / TODOUBLE(iterations), "ns", iterations, checksum);
+}
+
+void BenchmarkLookups(JsonConfig& cfg, json& root, size_t iterations)
+{
+    struct Case
+    {
+        string section;
+        string key;
+    };
+    const vector<Case> cases = {{"log", "maxWriteDelay"},
+                                {"log.email", "maxConcurrentDeliveries"},
+                                {"log.email.someRecipients", "maxDelay"},
+                                {"log.email.someRecipients", "missingKey"}};
+
+    for (const auto& c : cases)
+    {
+        const string suite = "lookup " + c.section + "." + c.key;
+        const ConfigPath path(ConfigPath(c.section), c.key);
+        const string fullPath = c.section + "." + c.key;
+        PrintSuite(suite);
+        Measure(suite, "split + contains + operator[] (reference)", iterations,
+                [&]()
+                {
+                    const json* value = SplitFindKey(root, c.section, c.key);
+                    return value ? value->get<size_t>() : 0;
+                });
+        Measure(suite, "GetJson(path) (FindKey)", iterations, [&]() { return cfg.GetJson(fullPath) ? 1 : 0; });
+        Measure(suite, "GetNumber(section, key, default)", iterations, [&]() { return TOSIZE(cfg.GetNumber(c.section, c.key, 0)); });
+        Measure(suite, "GetNumber(ConfigPath, default)", iterations, [&]() { return TOSIZE(cfg.GetNumber(path, 0)); });
+        Measure(suite, "ConfigPath parsing + GetNumber", iterations,
+                [&]() { return TOSIZE(cfg.GetNumber(ConfigPath(ConfigPath(c.section), c.key), 0)); });
+    }
+}
+
+void BenchmarkGetters(JsonConfig& cfg, size_t iterations)
+{
+    struct Case
+    {
+        string section;
+        string key;  // of a string value
+    };
+    const vector<Case> cases = {
+        {"log", "filePath"}, {"log.email", "spoolDir"}, {"log.email.someRecipients", "emailSection"}};
+
+    for (const auto& c : cases)
+    {
+        const string suite = "getters " + c.section;
+        const ConfigPath path(ConfigPath(c.section), c.key);
+        const ConfigPath sectionPath(c.section);
+        PrintSuite(suite);
+        Measure(suite, "GetString(section, key)", iterations, [&]() { return cfg.GetString(c.section, c.key).length(); });
+        Measure(suite, "GetString(ConfigPath)", iterations, [&]() { return cfg.GetString(path).length(); });
+        Measure(suite, "GetView(ConfigPath).GetString(key)", iterations,
+                [&]() { return cfg.GetView(sectionPath).GetString(c.key).length(); });
+        Measure(suite, "GetKeys(section)", iterations, [&]() { return cfg.GetKeys(c.section, true, true, true).size(); });
+        Measure(suite, "GetView(ConfigPath).GetKeys()", iterations,
+                [&]()
+                {
+                    size_t length = 0;
+                    for (const string_view key : cfg.GetView(sectionPath).GetKeys(true, true, true))
+                    {
+                        length += key.length();
+                    }
+                    return length;
+                });
+    }
+
+    const string suite = "getters string arrays";
+    const ConfigPath sectionPath("log.email.someRecipients");
+    PrintSuite(suite);
+    Measure(suite, "GetStringVector(section, key)", iterations,
+            [&]() { return cfg.GetStringVector("log.email.someRecipients", "recipients").size(); });
+    Measure(suite, "GetView(ConfigPath).GetStrings(key)", iterations,
+            [&]()
+            {
+                size_t length = 0;
+                for (const string_view recipient : cfg.GetView(sectionPath).GetStrings("recipients"))
+                {
+                    length += recipient.length();
+                }
+                return length;
+            });
+}
+
+void BenchmarkNumbers(size_t iterations)
+{
+    struct Case
+    {
+        string name;
+        json value;
+        ConfigUnit unit;
+    };
+    const vector<Case> cases = {{"number", 10000000, ConfigUnit::None},
+                                {"floating point number", 2.5, ConfigUnit::None},
+                                {"decimal string", "10000000", ConfigUnit::None},
+                                {"negative decimal string", "-273", ConfigUnit::None},
+                                {"hex string", "0x989680", ConfigUnit::None},
+                                {"binary string", "0b100110001001011010000000", ConfigUnit::None},
+                                {"digit separators", "10_000_000", ConfigUnit::None},
+                                {"size with a unit", "10MB", ConfigUnit::Bytes},
+                                {"interval with a unit", "500ms", ConfigUnit::Milliseconds},
+                                {"interval in minutes", "5min", ConfigUnit::Milliseconds},
+                                {"invalid string", "10 apples", ConfigUnit::None}};
+
+    const string suite = "numbers";
+    PrintSuite(suite);
+    for (const auto& c : cases)
+    {
+        Measure(suite, "TryParseNumber<int64_t>, " + c.name, iterations,
+                [&]()
+                {
+                    int64_t value = 0;
+                    return JsonConfig::TryParseNumber(c.value, value, c.unit) ? static_cast<size_t>(value) : 0;
+                });
+    }
+    const json number = "0x7FFFFFFF";
+    Measure(suite, "TryParseNumber<double>, hex string", iterations,
+            [&]()
+            {
+                double value = 0;
+                return JsonConfig::TryParseNumber(number, value) ? static_cast<size_t>(value) : 0;
+            });
+}
+
+struct BenchmarkSettings
+{
+    vector<string> args;
+    string workDir;
+    int restartDelay = 0;
+    uint64_t shutdownTime = 0;
+    int watchdogTimeout = 0;
+};
+
+// restartDelay is left out, because nlohmann can't convert "5s"
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(BenchmarkSettings, args, workDir, shutdownTime, watchdogTimeout)
+
+void BenchmarkSections(JsonConfig& cfg, size_t iterations)
+{
+    static const auto schema = ConfigSchema<BenchmarkSettings>()
+                                   .Field("args", &BenchmarkSettings::args)
+                                   .Field("workDir", &BenchmarkSettings::workDir)
+                                   .Field("restartDelay", &BenchmarkSettings::restartDelay, 5000, 0, INT_MAX, ConfigUnit::Milliseconds)
+                                   .Field("shutdownTime", &BenchmarkSettings::shutdownTime, 10000)
+                                   .Field("watchdogTimeout", &BenchmarkSettings::watchdogTimeout, 0, 0, INT_MAX, ConfigUnit::Seconds);
+
+    const string suite = "sections";
+    PrintSuite(suite);
+    Measure(suite, "ParseSection<T>(section) (nlohmann from_json)", iterations,
+            [&]() { return cfg.ParseSection<BenchmarkSettings>("svcWatchDog").shutdownTime; });
+    Measure(suite, "ConfigSchema<T>::Bind(cfg, section)", iterations,
+            [&]()
+            {
+                const auto settings = schema.Bind(cfg, "svcWatchDog");
+                return TOSIZE(settings.restartDelay) + settings.shutdownTime;
+            });
+}
+
+// Writes a configuration file of roughly the given size: the usual sections, followed by a big generated section, like the
+// ones our generators add for the supervised applications. Size 0 writes just the usual sections.
+void WriteLargeConfiguration(const filesystem::path& filePath, size_t megabytes)
+{
+    ofstream file(filePath, ios::binary);
+    string text = CreateConfiguration().dump(4);
+    if (megabytes == 0)
+    {
+        file << text;
+        return;
+    }
+
+    text.pop_back();  // the closing brace
+    text += ",\n    \"generated\": {\n";
+    file << text;
+
+    const size_t targetSize = megabytes * 1024 * 1024;
+    size_t size = text.length();
+    for (size_t i = 0; size < targetSize; i++)
+    {
+        const json item = {{"id", i},
+                           {"name", "item" + to_string(i)},
+                           {"enabled", i % 3 != 0},
+                           {"weight", TODOUBLE(i) / 7},
+                           {"tags", {"alpha", "beta", to_string(i % 100)}},
+                           {"limits", {{"min", i % 10}, {"max", i % 1000}}}};
+        text = (i == 0 ? "        \"" : ",\n        \"") + to_string(i) + "\": " + item.dump();
+        file << text;
+        size += text.length();
+    }
+    file << "\n    }\n}\n";
+}
+
+// Loads the file the given way a few times and prints the best time in milliseconds.
+void MeasureLoad(const string& suite, const string& name, const function<size_t()>& load)
+{
+    const int attempts = 3;
+    double best = 0;
+    size_t checksum = 0;
+    for (int i = 0; i < attempts; i++)
+    {
+        const auto start = chrono::steady_clock::now();
+        checksum = load();
+        const auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        best = i == 0 ? elapsed : min(best, elapsed);
+    }
+
+    PrintResult(suite, name, best, "ms", attempts, checksum);
+}
+
+void BenchmarkLoad(size_t megabytes)
+{
+    const filesystem::path filePath = filesystem::temp_directory_path() / "JsonConfigBenchmark.json";
+    const filesystem::path cachePath = filesystem::path(filePath).concat(".cache");
+    WriteLargeConfiguration(filePath, megabytes);
+    const string suite = "load " + to_string(megabytes) + " MB";
+    if (!jsonOutput)
+    {
+        cout << "loading " << filePath.string() << " (" << filesystem::file_size(filePath) << " bytes):\n";
+    }
+
+    // the checksum is the number of the loaded top-level sections
+    MeasureLoad(suite, "LoadTextFile + json::parse (reference)", [&]() { return json::parse(LoadTextFile(filePath)).size(); });
+    MeasureLoad(suite, "Load(path)",
+                [&]()
+                {
+                    JsonConfig cfg;
+                    cfg.Load(filePath);
+                    return cfg.GetSnapshot()->size();
+                });
+    // the sections the service loads with svcWatchDog.configCache, see Source/SvcWatchDog/Main.cpp
+    MeasureLoad(suite, "Load(path, service sections)",
+                [&]()
+                {
+                    JsonConfig cfg;
+                    cfg.Load(filePath, {"svcWatchDog", "log", "cryptoTools", "smtp"});
+                    return cfg.GetSnapshot()->size();
+                });
+
+    // the first load writes the cache, the best time is the one of a cached load
+    MeasureLoad(suite, "Load(path, service sections) + cache",
+                [&]()
+                {
+                    JsonConfig cfg;
+                    cfg.SetCacheFile(cachePath);
+                    cfg.Load(filePath, {"svcWatchDog", "log", "cryptoTools", "smtp"});
+                    return cfg.GetSnapshot()->size();
+                });
+
+    filesystem::remove(cachePath);
+    filesystem::remove(filePath);
+}
+
+int main(int argc, char* argv[])
+{
+    int argument = 1;
+    if (argument < argc && string(argv[argument]) == "-j")
+    {
+        jsonOutput = true;
+        argument++;
+    }
+
+    if (argument < argc && string(argv[argument]) == "-l")
+    {
+        vector<size_t> sizes;
+        for (argument++; argument < argc; argument++)
+        {
+            char* end;
+            sizes.push_back(strtoul(argv[argument], &end, 10));
+            if (*end != 0 || *argv[argument] == 0)
+            {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        }
+        if (sizes.empty())
+        {
+            sizes = {0, 1, 10, 50};
+        }
+
+        for (const size_t megabytes : sizes)
+        {
+            BenchmarkLoad(megabytes);
+        }
+        return 0;
+    }
+
+    size_t iterations = 1000000;
+    if (argc - argument > 1 || (argc - argument == 1 && (iterations = strtoul(argv[argument], nullptr, 10)) == 0))
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    JsonConfig cfg;
+    json root = CreateConfiguration();
+    cfg.SetJson(root);
+
+    BenchmarkLookups(cfg, root, iterations);
+    BenchmarkGetters(cfg, iterations);
+    BenchmarkNumbers(iterations);
+    // binding a whole section costs much more than a lookup
+    BenchmarkSections(cfg, max<size_t>(iterations / 10, 1));
+
+    return 0;
+}
@@ -0,0 +1,166 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#include <JsonConfig/JsonConfig.h>
+#include <Logger/Logger.h>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+template <typename T>
+bool Parses(const json& parameter, T expected, ConfigUnit unit = ConfigUnit::None)
+{
+    T value{};
+    return JsonConfig::TryParseNumber(parameter, value, unit) && value == expected;
+}
+
+template <typename T>
+bool IsRejected(const json& parameter, ConfigUnit unit = ConfigUnit::None)
+{
+    T value{};
+    return !JsonConfig::TryParseNumber(parameter, value, unit);
+}
+
+// Loads the sections of the configuration file with the given text and returns the loaded configuration.
+json LoadSections(string_view text, const vector<string>& sections)
+{
+    error_code ec;
+    const auto path = filesystem::temp_directory_path(ec) / "SvcWatchDogJsonConfigTest.json";
+    ofstream(path, ios::binary | ios::trunc) << text;
+
+    JsonConfig cfg;
+    cfg.Load(path, sections);
+    filesystem::remove(path, ec);
+    return *cfg.GetJson("");
+}
+
+// Returns the message of the error the sections can't be loaded with, or an empty string, if they can.
+string LoadError(string_view text, const vector<string>& sections)
+{
+    try
+    {
+        LoadSections(text, sections);
+    }
+    catch (const runtime_error& e)
+    {
+        return e.what();
+    }
+    return "";
+}
+}  // namespace
+
+void JsonConfigTest()
+{
+    // floating point numbers at the limits of the integer types; 2^63 and 2^64 are what the maximums round to in double
+    LOGASSERT(IsRejected<int64_t>(9.223372036854776e18));
+    LOGASSERT(IsRejected<uint64_t>(1.8446744073709552e19));
+    LOGASSERT(Parses<uint64_t>(9.223372036854776e18, 9223372036854775808ULL));
+    LOGASSERT(Parses<int64_t>(9.2233720368547748e18, 9223372036854774784LL));
+    LOGASSERT(Parses<int64_t>(-9.223372036854776e18, INT64_MIN));
+    LOGASSERT(IsRejected<int64_t>(-9.2233720368547779e18));
+    LOGASSERT(Parses<int32_t>(2147483647.9, INT32_MAX));
+    LOGASSERT(IsRejected<int32_t>(2147483648.0));
+    LOGASSERT(Parses<uint8_t>(255.5, 255));
+    LOGASSERT(IsRejected<uint8_t>(256.0));
+    LOGASSERT(IsRejected<uint8_t>(-0.5));
+    LOGASSERT(Parses<int8_t>(-128.0, -128));
+    LOGASSERT(IsRejected<int8_t>(-129.0));
+    LOGASSERT(IsRejected<float>(1e300));
+    LOGASSERT(Parses<double>(1e300, 1e300));
+
+    // integers
+    LOGASSERT(Parses<uint64_t>(UINT64_MAX, UINT64_MAX));
+    LOGASSERT(IsRejected<int64_t>(UINT64_MAX));
+    LOGASSERT(Parses<int64_t>(INT64_MIN, INT64_MIN));
+    LOGASSERT(IsRejected<uint32_t>(-1));
+    LOGASSERT(Parses<int>(true, 1));
+
+    // strings
+    LOGASSERT(Parses<int64_t>("0x7FFFFFFFFFFFFFFF", INT64_MAX));
+    LOGASSERT(IsRejected<int64_t>("0x8000000000000000"));
+    LOGASSERT(Parses<int64_t>("-0x8000000000000000", INT64_MIN));
+    LOGASSERT(Parses<uint64_t>("18446744073709551615", UINT64_MAX));
+    LOGASSERT(IsRejected<uint64_t>("18446744073709551616"));
+    LOGASSERT(IsRejected<uint32_t>("-1"));
+    LOGASSERT(Parses<uint32_t>("-0", 0));
+    LOGASSERT(Parses<int>("0b101", 5));
+    LOGASSERT(Parses<int>("1_000_000", 1000000));
+    LOGASSERT(Parses<int>("1'000", 1000));
+    LOGASSERT(IsRejected<int>("10 apples"));
+    LOGASSERT(IsRejected<int>(""));
+
+    // units
+    LOGASSERT(Parses<uint64_t>("10MB", 10485760, ConfigUnit::Bytes));
+    LOGASSERT(IsRejected<uint64_t>("10MB"));
+    LOGASSERT(IsRejected<uint64_t>("16777216TB", ConfigUnit::Bytes));
+    LOGASSERT(Parses<int>("5s", 5000, ConfigUnit::Milliseconds));
+    LOGASSERT(Parses<int>("2min", 120, ConfigUnit::Seconds));
+    LOGASSERT(Parses<int>("2000ms", 2, ConfigUnit::Seconds));
+    LOGASSERT(IsRejected<int>("1500ms", ConfigUnit::Seconds));
+    LOGASSERT(IsRejected<int32_t>("25d", ConfigUnit::Milliseconds));
+
+    // loading only some sections; the others are skipped without being parsed, even if their strings contain quotes and brackets
+    const vector<string> sections = {"keep", "a\"b"};
+    json parsed = LoadSections(R"({"skip": {"x": "\"}]", "y": ["\\", "[{"], "z": -1.5e3}, "keep": {"v": "q\"}"}, "n": null})", sections);
+    LOGASSERT(parsed == json({{"keep", {{"v", "q\"}"}}}}));
+    parsed = LoadSections(R"({"k\u0065ep": 1, "a\"b": [2]})", sections);
+    LOGASSERT(parsed == json({{"keep", 1}, {"a\"b", {2}}}));
+    LOGASSERT(LoadSections("\xEF\xBB\xBF {\"keep\": true}", sections) == json({{"keep", true}}));
+    LOGASSERT(LoadSections("{}", sections) == json::object());
+    LOGASSERT(LoadSections(" \r\n{ }\n", sections) == json::object());
+
+    // syntax errors, also in the skipped sections (for example mismatched brackets), are reported with their line and column
+    LOGASSERT(LoadError(R"({"keep": 1,})", sections).starts_with("invalid JSON at line 1, column 12: expected a section name"));
+    LOGASSERT(LoadError("{\"keep\": 1}\n x", sections).starts_with("invalid JSON at line 2, column 2: unexpected text after the end"));
+    const string text = "{\n  \"keep\": 1,\n  \"skip\": [1}\n}";
+    LOGASSERT(LoadError(text, sections).starts_with("invalid JSON at line 3, column 13: expected ']'"));
+    LOGASSERT(LoadError(R"({"skip": {"x": [}]})", sections).starts_with("invalid JSON at line 1, column 17: expected ']'"));
+    LOGASSERT(LoadError(R"({"skip": "\"})", sections).starts_with("invalid JSON at line 1, column 14: unterminated string"));
+    LOGASSERT(LoadError(R"({"skip": {"x": 1)", sections).starts_with("invalid JSON at line 1, column 17: unexpected end of input"));
+    LOGASSERT(LoadError(R"({"keep": 1)", sections).starts_with("invalid JSON at line 1, column 11: expected ',' or '}'"));
+    LOGASSERT(LoadError(R"({"keep": , "x": 1})", sections).starts_with("invalid JSON at line 1, column 10: expected a value"));
+    LOGASSERT(LoadError(R"({"keep" 1})", sections).starts_with("invalid JSON at line 1, column 9: expected ':'"));
+    LOGASSERT(LoadError(R"({"keep": 1 "x": 2})", sections).starts_with("invalid JSON at line 1, column 12: expected ',' or '}'"));
+    LOGASSERT(LoadError(R"({"keep": {"v": tru}})", sections).starts_with("invalid JSON at line 1, column "));
+    LOGASSERT(LoadError("[]", sections).starts_with("invalid JSON at line 1, column 1: expected '{'"));
+
+    // the values returned by GetJson() keep their snapshot alive, when it's replaced
+    JsonConfig cfg;
+    cfg.SetJson({{"a", {{"b", 1}}}});
+    const auto value = cfg.GetJson("a.b");
+    cfg.SetJson(json::object());
+    LOGASSERT(value && *value == 1);
+    LOGASSERT(!cfg.GetJson("a.b"));
+
+    LOGSTR() << "JsonConfig test completed";
+}
@@ -0,0 +1,441 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+// Command line tool, which measures the end-to-end email alert throughput and latency on localhost. It starts a local
+// SMTP sink (see Include/Test/SmtpSink.h), configures the logger with one or more email plugins pointing to it, logs the
+// requested number of alerts and waits until all of them arrive at the sink. The latency is measured from the LOGSTR()
+// call to the moment the sink has received the end of the email data, so it covers the logger, the plugin batching,
+// the delivery pool and the SMTP session. With -s, the emails are sent one by one directly through EmailSender instead, which
+// measures the SMTP session alone and shows what reusing the connection saves (compare with -i 0). With -x, it only runs the
+// self-tests of the SmtpSink, the EmailSpool and the EmailCircuitBreaker (see Source/Test/SmtpSinkTest.cpp,
+// Source/Test/EmailSpoolTest.cpp and Source/Test/EmailCircuitBreakerTest.cpp).
+// Build it together with Source/Test/SmtpSink.cpp, the logger, email, JsonConfig, SimpleTools and CryptoTools sources,
+// and link it with libcurl, zlib and Botan (or define SMTPSINK_NO_TLS to build it without Botan and without the -t option).
+
+#include <Logger/Logger.h>
+#include <Logger/LoggerEmailPlugin.h>
+#include <Email/EmailSender.h>
+#include <CryptoTools/CryptoTools.h>
+#include <Test/SmtpSink.h>
+#include <Test/SmtpSinkTest.h>
+#include <Test/EmailSpoolTest.h>
+#include <Test/EmailCircuitBreakerTest.h>
+#include <curl/curl.h>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct BenchmarkOptions
+{
+    size_t alerts = 1000;
+    int rate = 0;  // alerts per second, 0 means as fast as possible
+    int latency = 0;
+    double failureRate = 0;
+    bool tls = false;
+    int urgentDelay = 0;
+    int maxWriteDelay = 50;
+    int maxConcurrentDeliveries = 8;
+    size_t plugins = 1;
+    int timeout = 60000;
+    bool direct = false;
+    int idleTimeout = 60000;
+    bool selfTest = false;
+};
+
+void PrintUsage(const char* programName)
+{
+    cout << "SMTP Benchmark - measures the email alert throughput and latency against a local SMTP sink\n\n";
+    cout << "Usage: " << programName << " [options]\n\n";
+    cout << "Options:\n";
+    cout << "  -n <count>    Number of alerts to log (default 1000)\n";
+    cout << "  -r <rate>     Alerts per second, 0 means as fast as possible (default 0)\n";
+    cout << "  -l <ms>       Latency, injected by the sink before the greeting and each reply to DATA (default 0)\n";
+    cout << "  -f <share>    Share of emails (0 to 1), rejected by the sink with a temporary error (default 0)\n";
+    cout << "  -t            Use STARTTLS with a self-signed certificate\n";
+    cout << "  -u <ms>       urgentDelay of the email plugins (default 0)\n";
+    cout << "  -w <ms>       maxWriteDelay of the logger (default 50)\n";
+    cout << "  -c <count>    maxConcurrentDeliveries of the delivery pool (default 8)\n";
+    cout << "  -p <count>    Number of email plugins, each with its own recipient (default 1)\n";
+    cout << "  -o <ms>       How long to wait for the emails after the last alert (default 60000)\n";
+    cout << "  -s            Send <count> emails one by one through EmailSender, without the logger\n";
+    cout << "  -i <ms>       idleTimeout of the SMTP section, 0 opens a new connection for every email (default 60000)\n";
+    cout << "  -x            Only run the self-tests of the SMTP sink (also STARTTLS, if available), the spool and the circuit breaker\n\n";
+    cout << "Description:\n";
+    cout << "  Every alert is an Error log, which the plugins treat as urgent. The results include the alert\n";
+    cout << "  throughput, the number of emails and the latency percentiles, measured over all plugins.\n";
+    cout << "  With -s, the results are the latencies of the first email and of the following ones, measured\n";
+    cout << "  around each call of EmailSender::SendSimpleEmail.\n\n";
+    cout << "Examples:\n";
+    cout << "  " << programName << " -n 5000 -r 500 -l 20 -p 4\n";
+    cout << "  " << programName << " -s -n 20 -l 50 -i 0\n\n";
+}
+
+bool ParseArguments(int argc, char* argv[], BenchmarkOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const string arg = argv[i];
+        if (arg == "-t")
+        {
+            options.tls = true;
+            continue;
+        }
+        if (arg == "-s")
+        {
+            options.direct = true;
+            continue;
+        }
+        if (arg == "-x")
+        {
+            options.selfTest = true;
+            continue;
+        }
+        if (arg.length() != 2 || arg[0] != '-' || i + 1 >= argc)
+        {
+            return false;
+        }
+
+        const string value = argv[++i];
+        try
+        {
+            switch (arg[1])
+            {
+                case 'n':
+                    options.alerts = stoul(value);
+                    break;
+                case 'r':
+                    options.rate = stoi(value);
+                    break;
+                case 'l':
+                    options.latency = stoi(value);
+                    break;
+                case 'f':
+                    options.failureRate = stod(value);
+                    break;
+                case 'u':
+                    options.urgentDelay = stoi(value);
+                    break;
+                case 'w':
+                    options.maxWriteDelay = stoi(value);
+                    break;
+                case 'c':
+                    options.maxConcurrentDeliveries = stoi(value);
+                    break;
+                case 'p':
+                    options.plugins = stoul(value);
+                    break;
+                case 'o':
+                    options.timeout = stoi(value);
+                    break;
+                case 'i':
+                    options.idleTimeout = stoi(value);
+                    break;
+                default:
+                    return false;
+            }
+        }
+        catch (const exception&)
+        {
+            return false;
+        }
+    }
+
+#ifdef SMTPSINK_NO_TLS
+    if (options.tls)
+    {
+        cerr << "STARTTLS is not available in this build\n";
+        return false;
+    }
+#endif
+
+    return options.alerts > 0 && options.plugins > 0 && options.rate >= 0;
+}
+
+json CreateConfiguration(const BenchmarkOptions& options, uint16_t port)
+{
+    json plugins = json::object();
+    for (size_t i = 0; i < options.plugins; i++)
+    {
+        plugins["p" + to_string(i)] = {{"minLogLevel", TOINT(Error)},
+                                       {"recipients", {"p" + to_string(i) + "@localhost"}},
+                                       {"emailSection", "smtp"},
+                                       {"maxLogs", 1000},
+                                       {"urgentLevel", TOINT(Error)},
+                                       {"urgentDelay", options.urgentDelay},
+                                       {"digest", false}};
+    }
+    plugins["maxConcurrentDeliveries"] = options.maxConcurrentDeliveries;
+    plugins["maxPendingEmails"] = 1000;
+
+    return {{"log", {{"minConsoleLevel", TOINT(Fatal)}, {"maxWriteDelay", options.maxWriteDelay}, {"email", plugins}}},
+            {"smtp",
+             {{"smtpServerUrl", "smtp://127.0.0.1:" + to_string(port)},
+              {"sslFlag", options.tls ? TOINT(CURLUSESSL_ALL) : TOINT(CURLUSESSL_NONE)},
+              {"sslVerifyPeer", false},
+              {"defaultSourceAddress", "benchmark@localhost"},
+              {"timeout", 10000},
+              {"idleTimeout", options.idleTimeout},
+              {"circuitBreakerThreshold", 0}}}};
+}
+
+// Finds all "benchmark alert <n>" lines in the email and adds their latencies; returns the number of alerts found.
+size_t CollectLatencies(const SmtpSinkMessage& message, const vector<uint64_t>& logTimes, vector<uint64_t>& latencies)
+{
+    static const string marker = "benchmark alert ";
+    size_t found = 0;
+    for (size_t pos = message.data.find(marker); pos != string::npos; pos = message.data.find(marker, pos))
+    {
+        pos += marker.length();
+        size_t alert = 0;
+        while (pos < message.data.length() && isdigit(TOUCHAR(message.data[pos])))
+        {
+            alert = alert * 10 + TOSIZE(message.data[pos++] - '0');
+        }
+        if (alert < logTimes.size())
+        {
+            latencies.push_back(message.receivedTime >= logTimes[alert] ? message.receivedTime - logTimes[alert] : 0);
+            found++;
+        }
+    }
+    return found;
+}
+
+uint64_t Percentile(const vector<uint64_t>& sorted, double percentile)
+{
+    return sorted.empty() ? 0 : sorted[min(sorted.size() - 1, TOSIZE(percentile * static_cast<double>(sorted.size())))];
+}
+
+// Sends the emails one after another and measures each call, in microseconds.
+int RunSenderBenchmark(const BenchmarkOptions& options)
+{
+    vector<uint64_t> latencies;
+    size_t sent = 0;
+    {
+        Logger logger;
+        Logger::SetInstance(&logger);
+        Lg.Configure(Cfg);
+        Lg.Start();
+
+        CryptoTools cryptoTools;
+        CryptoTools::SetInstance(&cryptoTools);
+        cryptoTools.Configure(Cfg, "cryptoTools", "A7k2TDrZkf3kMCGMmBhA");
+
+        EmailSender sender;
+        sender.Configure(Cfg, "smtp");
+        for (size_t i = 0; i < options.alerts; i++)
+        {
+            const Stopwatch stopwatch;
+            if (sender.SendSimpleEmail("benchmark", "benchmark email " + to_string(i), {"direct@localhost"}) == CURLE_OK)
+            {
+                sent++;
+            }
+            latencies.push_back(TOUINT64(stopwatch.ElapsedWallMilliseconds() * 1000));
+        }
+        sender.CloseConnection();
+
+        Lg.Shutdown();
+        CryptoTools::SetInstance(nullptr);
+        Logger::SetInstance(nullptr);
+    }
+
+    const uint64_t first = latencies.front();
+    latencies.erase(latencies.begin());
+    sort(latencies.begin(), latencies.end());
+
+    cout << fixed << setprecision(2);
+    cout << "emails sent:      " << sent << " of " << options.alerts << "\n";
+    cout << "first email (ms): " << first / 1000.0 << "\n";
+    cout << "next emails (ms): min " << Percentile(latencies, 0) / 1000.0 << ", median " << Percentile(latencies, 0.5) / 1000.0
+         << ", p90 " << Percentile(latencies, 0.9) / 1000.0 << ", max " << (latencies.empty() ? 0 : latencies.back()) / 1000.0 << "\n";
+
+    return sent == options.alerts ? 0 : 2;
+}
+
+// Returns 0 if there were no assertion failures.
+int RunSelfTest()
+{
+    JsonConfig cfg;
+    cfg.SetJson({{"log", {{"minConsoleLevel", TOINT(Information)}}}});
+
+    Logger logger;
+    Logger::SetInstance(&logger);
+    logger.Configure(cfg);
+    logger.Start();
+
+    SmtpSinkTest(false);
+#ifndef SMTPSINK_NO_TLS
+    SmtpSinkTest(true);
+#else
+    LOGSTR(Warning) << "STARTTLS is not available in this build, so it was not tested";
+#endif
+    EmailSpoolTest();
+    EmailCircuitBreakerTest();
+
+    const uint64_t failures = Lg.GetStatistics().records[Fatal];
+    Lg.Shutdown();
+    Logger::SetInstance(nullptr);
+
+    cout << "self-test: " << (failures == 0 ? "passed" : to_string(failures) + " assertion failure(s)") << "\n";
+    return failures == 0 ? 0 : 2;
+}
+
+int RunBenchmark(const BenchmarkOptions& options)
+{
+    SmtpSink sink;
+    if (!sink.Start(0, options.tls))
+    {
+        cerr << "unable to start the SMTP sink\n";
+        return 1;
+    }
+    sink.SetLatency(options.latency);
+    sink.SetFailureRate(options.failureRate);
+
+    JsonConfig cfg;
+    JsonConfig::SetInstance(&cfg);
+    cfg.SetJson(CreateConfiguration(options, sink.GetPort()));
+    if (options.direct)
+    {
+        return RunSenderBenchmark(options);
+    }
+
+    vector<uint64_t> logTimes(options.alerts);
+    vector<uint64_t> latencies;
+    latencies.reserve(options.alerts * options.plugins);
+    size_t emails = 0;
+    uint64_t startTime;
+    uint64_t logEndTime;
+    uint64_t endTime;
+    {
+        Logger logger;
+        Logger::SetInstance(&logger);
+        Lg.Configure(Cfg);
+        Lg.Start();
+
+        CryptoTools cryptoTools;
+        CryptoTools::SetInstance(&cryptoTools);
+        cryptoTools.Configure(Cfg, "cryptoTools", "A7k2TDrZkf3kMCGMmBhA");
+
+        LoggerEmailPlugin::ConfigureAll(Cfg, Lg);
+
+        startTime = SteadyTime();
+        for (size_t i = 0; i < options.alerts; i++)
+        {
+            if (options.rate > 0)
+            {
+                const uint64_t dueTime = startTime + i * 1000 / TOSIZE(options.rate);
+                const uint64_t now = SteadyTime();
+                if (dueTime > now)
+                {
+                    SLEEP(TOINT(dueTime - now));
+                }
+            }
+            logTimes[i] = SteadyTime();
+            LOGSTR(Error) << "benchmark alert " << i;
+        }
+        logEndTime = SteadyTime();
+
+        // wait for all the alerts to arrive at the sink
+        const size_t expected = options.alerts * options.plugins;
+        const uint64_t deadline = logEndTime + TOUINT64(options.timeout);
+        endTime = logEndTime;
+        while (latencies.size() < expected && SteadyTime() < deadline)
+        {
+            sink.WaitForMessages(1, 100);
+            for (const auto& message : sink.TakeMessages())
+            {
+                if (CollectLatencies(message, logTimes, latencies) > 0)
+                {
+                    emails++;
+                    endTime = max(endTime, message.receivedTime);
+                }
+            }
+        }
+
+        Lg.Shutdown();
+        CryptoTools::SetInstance(nullptr);
+        Logger::SetInstance(nullptr);
+    }
+    sink.Stop();
+
+    sort(latencies.begin(), latencies.end());
+    const size_t expected = options.alerts * options.plugins;
+    const double logSeconds = max(TOINT(logEndTime - startTime), 1) / 1000.0;
+    const double totalSeconds = max(TOINT(endTime - startTime), 1) / 1000.0;
+
+    cout << fixed << setprecision(1);
+    cout << "alerts logged:    " << options.alerts << " in " << logSeconds << " s (" << options.alerts / logSeconds << "/s)\n";
+    cout << "alerts delivered: " << latencies.size() << " of " << expected << " in " << emails << " emails, " << totalSeconds
+         << " s (" << latencies.size() / totalSeconds << "/s)\n";
+    cout << "latency (ms):     min " << Percentile(latencies, 0) << ", median " << Percentile(latencies, 0.5) << ", p90 "
+         << Percentile(latencies, 0.9) << ", p99 " << Percentile(latencies, 0.99) << ", max "
+         << (latencies.empty() ? 0 : latencies.back()) << "\n";
+
+    return latencies.size() == expected ? 0 : 2;
+}
+
+int main(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    if (!ParseArguments(argc, argv, options))
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+#ifdef WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+    {
+        cerr << "WSAStartup failed\n";
+        return 1;
+    }
+#endif
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    int returnCode;
+    try
+    {
+        returnCode = options.selfTest ? RunSelfTest() : RunBenchmark(options);
+    }
+    catch (const exception& e)
+    {
+        cerr << "benchmark failed: " << e.what() << "\n";
+        returnCode = 1;
+    }
+
+    curl_global_cleanup();
+#ifdef WIN32
+    WSACleanup();
+#endif
+
+    return returnCode;
+}
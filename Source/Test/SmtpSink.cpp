@@ -0,0 +1,556 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#ifdef WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define SHUT_RDWR SD_BOTH
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#include <Test/SmtpSink.h>
+
+#ifndef SMTPSINK_NO_TLS
+#include <botan/auto_rng.h>
+#include <botan/credentials_manager.h>
+#include <botan/ecdsa.h>
+#include <botan/tls_callbacks.h>
+#include <botan/tls_policy.h>
+#include <botan/tls_server.h>
+#include <botan/tls_session_manager_noop.h>
+#include <botan/x509self.h>
+#endif
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+namespace
+{
+bool SendAll(SOCKET socket, string_view data)
+{
+    while (!data.empty())
+    {
+        const int sent = send(socket, data.data(), TOINT(min<size_t>(data.length(), 65536)), MSG_NOSIGNAL);
+        if (sent <= 0)
+        {
+            return false;
+        }
+        data.remove_prefix(TOSIZE(sent));
+    }
+    return true;
+}
+
+// Returns the address between the angle brackets, for example "a@b.c" from "MAIL FROM:<a@b.c> SIZE=123".
+string GetAddress(const string& line)
+{
+    const auto start = line.find('<');
+    const auto end = line.find('>', start);
+    return start == string::npos || end == string::npos ? "" : line.substr(start + 1, end - start - 1);
+}
+
+#ifndef SMTPSINK_NO_TLS
+// Provides the self-signed certificate, generated once for the lifetime of the sink.
+class SinkCredentials : public Botan::Credentials_Manager
+{
+   public:
+    SinkCredentials()
+    {
+        Botan::AutoSeeded_RNG rng;
+        m_key = make_shared<Botan::ECDSA_PrivateKey>(rng, Botan::EC_Group::from_name("secp256r1"));
+
+        Botan::X509_Cert_Options options("localhost");
+        options.dns = "localhost";
+        m_chain.push_back(Botan::X509::create_self_signed_cert(options, *m_key, "SHA-256", rng));
+    }
+
+    vector<Botan::X509_Certificate> cert_chain(const vector<string>& keyTypes, const vector<Botan::AlgorithmIdentifier>&,
+                                               const string& type, const string&) override
+    {
+        return type == "tls-server" && ranges::find(keyTypes, "ECDSA") != keyTypes.end() ? m_chain : vector<Botan::X509_Certificate>();
+    }
+
+    shared_ptr<Botan::Private_Key> private_key_for(const Botan::X509_Certificate&, const string&, const string&) override { return m_key; }
+
+   private:
+    shared_ptr<Botan::Private_Key> m_key;
+    vector<Botan::X509_Certificate> m_chain;
+};
+#endif
+}  // namespace
+
+#ifndef SMTPSINK_NO_TLS
+struct SmtpSink::TlsContext
+{
+    shared_ptr<SinkCredentials> credentials = make_shared<SinkCredentials>();
+    shared_ptr<const Botan::TLS::Policy> policy = make_shared<Botan::TLS::Policy>();
+};
+#else
+struct SmtpSink::TlsContext
+{
+};
+#endif
+
+// A client connection, which reads lines and writes replies, in plain text or (after STARTTLS) over TLS.
+class SmtpSink::Connection
+{
+   public:
+    explicit Connection(SOCKET socket) noexcept : m_socket(socket), m_closed(false) {}
+
+    // prevent copying and assignment
+    DELETE_COPY_AND_ASSIGNMENT(Connection);
+
+    // Reads the next line, without the line end; returns false when the connection is closed.
+    bool ReadLine(string& line)
+    {
+        for (;;)
+        {
+            const auto end = m_input.find('\n');
+            if (end != string::npos)
+            {
+                line.assign(m_input, 0, end > 0 && m_input[end - 1] == '\r' ? end - 1 : end);
+                m_input.erase(0, end + 1);
+                return true;
+            }
+            if (!Receive())
+            {
+                return false;
+            }
+        }
+    }
+
+    void Write(string_view text)
+    {
+#ifndef SMTPSINK_NO_TLS
+        if (m_server)
+        {
+            m_server->send(text);
+            return;
+        }
+#endif
+        m_closed = m_closed || !SendAll(m_socket, text);
+    }
+
+    // Performs the TLS handshake; the "220" reply to STARTTLS must already be written.
+    bool StartTls([[maybe_unused]] const TlsContext& context)
+    {
+#ifndef SMTPSINK_NO_TLS
+        // whatever the client sent before the handshake is not to be trusted
+        m_input.clear();
+        try
+        {
+            m_callbacks = make_shared<TlsCallbacks>(*this);
+            m_server = make_unique<Botan::TLS::Server>(m_callbacks, make_shared<Botan::TLS::Session_Manager_Noop>(), context.credentials,
+                                                       context.policy, make_shared<Botan::AutoSeeded_RNG>());
+            while (!m_server->is_active())
+            {
+                if (!Receive())
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        catch (const exception& e)
+        {
+            cerr << "SmtpSink: TLS handshake failed: " << e.what() << "\n";
+            return false;
+        }
+#else
+        return false;
+#endif
+    }
+
+    bool IsSecure() const noexcept
+    {
+#ifndef SMTPSINK_NO_TLS
+        return m_server != nullptr;
+#else
+        return false;
+#endif
+    }
+
+   private:
+    SOCKET m_socket;
+    string m_input;  // received (and decrypted) data, which is not processed yet
+    bool m_closed;
+
+#ifndef SMTPSINK_NO_TLS
+    class TlsCallbacks : public Botan::TLS::Callbacks
+    {
+       public:
+        explicit TlsCallbacks(Connection& connection) noexcept : m_connection(connection) {}
+
+        void tls_emit_data(span<const uint8_t> data) override
+        {
+            auto& c = m_connection;
+            c.m_closed = c.m_closed || !SendAll(c.m_socket, string_view(reinterpret_cast<const char*>(data.data()), data.size()));
+        }
+
+        void tls_record_received(uint64_t, span<const uint8_t> data) override
+        {
+            m_connection.m_input.append(reinterpret_cast<const char*>(data.data()), data.size());
+        }
+
+        void tls_alert(Botan::TLS::Alert alert) override
+        {
+            if (alert.type() == Botan::TLS::AlertType::CloseNotify || alert.is_fatal())
+            {
+                m_connection.m_closed = true;
+            }
+        }
+
+       private:
+        Connection& m_connection;
+    };
+
+    shared_ptr<TlsCallbacks> m_callbacks;
+    unique_ptr<Botan::TLS::Server> m_server;
+#endif
+
+    bool Receive()
+    {
+        char buffer[16384];
+        const int received = m_closed ? 0 : recv(m_socket, buffer, sizeof(buffer), 0);
+        if (received <= 0)
+        {
+            return false;
+        }
+
+#ifndef SMTPSINK_NO_TLS
+        if (m_server)
+        {
+            try
+            {
+                m_server->received_data(span<const uint8_t>(reinterpret_cast<const uint8_t*>(buffer), TOSIZE(received)));
+            }
+            catch (const exception&)
+            {
+                return false;
+            }
+            return !m_closed;
+        }
+#endif
+        m_input.append(buffer, TOSIZE(received));
+        return true;
+    }
+};
+
+SmtpSink::SmtpSink() noexcept : m_listenSocket(INVALID_SOCKET), m_port(0), m_running(false), m_latency(0), m_failureRate(0) {}
+
+SmtpSink::~SmtpSink() { Stop(); }
+
+bool SmtpSink::Start(uint16_t port, bool tls)
+{
+    if (m_running)
+    {
+        return false;
+    }
+
+    m_tls.reset();
+    if (tls)
+    {
+#ifndef SMTPSINK_NO_TLS
+        try
+        {
+            m_tls = make_unique<TlsContext>();
+        }
+        catch (const exception& e)
+        {
+            cerr << "SmtpSink: failed to create the certificate: " << e.what() << "\n";
+            return false;
+        }
+#else
+        cerr << "SmtpSink: built without TLS support\n";
+        return false;
+#endif
+    }
+
+    m_listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (m_listenSocket == INVALID_SOCKET)
+    {
+        return false;
+    }
+
+#ifndef WIN32
+    // allow quick restarts on the same port (on Windows, this option means something else)
+    const int reuse = 1;
+    setsockopt(m_listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = inet_addr("127.0.0.1");
+    address.sin_port = htons(port);
+    socklen_t addressLength = sizeof(address);
+    if (::bind(m_listenSocket, (sockaddr*)&address, sizeof(address)) == SOCKET_ERROR || listen(m_listenSocket, SOMAXCONN) == SOCKET_ERROR ||
+        getsockname(m_listenSocket, (sockaddr*)&address, &addressLength) == SOCKET_ERROR)
+    {
+        cerr << "SmtpSink: failed to listen on port " << port << "\n";
+        SAFE_CLOSE_SOCKET(m_listenSocket);
+        return false;
+    }
+    m_port = ntohs(address.sin_port);
+
+    m_running = true;
+    m_acceptThread = thread(&SmtpSink::AcceptThread, this);
+    return true;
+}
+
+void SmtpSink::Stop()
+{
+    if (!m_running.exchange(false))
+    {
+        return;
+    }
+
+    m_acceptThread.join();
+    SAFE_CLOSE_SOCKET(m_listenSocket);
+
+    // wake up the connection threads, which are waiting for data or sleeping out the injected latency
+    vector<thread> threads;
+    {
+        const lock_guard<mutex> lock(m_cs);
+        for (const auto socket : m_connectionSockets)
+        {
+            shutdown(socket, SHUT_RDWR);
+        }
+        threads = std::move(m_connectionThreads);
+        m_cv.notify_all();
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+}
+
+uint16_t SmtpSink::GetPort() const noexcept { return m_port; }
+
+void SmtpSink::SetLatency(int latency) noexcept { m_latency = latency; }
+
+void SmtpSink::SetFailureRate(double failureRate) noexcept { m_failureRate = failureRate; }
+
+size_t SmtpSink::GetMessageCount()
+{
+    const lock_guard<mutex> lock(m_cs);
+    return m_messages.size();
+}
+
+vector<SmtpSinkMessage> SmtpSink::TakeMessages()
+{
+    const lock_guard<mutex> lock(m_cs);
+    return std::move(m_messages);
+}
+
+bool SmtpSink::WaitForMessages(size_t count, int timeout)
+{
+    unique_lock<mutex> lock(m_cs);
+    return m_cv.wait_for(lock, chrono::milliseconds(timeout), [&]() { return m_messages.size() >= count; });
+}
+
+void SmtpSink::AddMessage(SmtpSinkMessage message)
+{
+    const lock_guard<mutex> lock(m_cs);
+    m_messages.push_back(std::move(message));
+    m_cv.notify_all();
+}
+
+void SmtpSink::AcceptThread()
+{
+    while (m_running)
+    {
+        // wait with a timeout, so Stop() doesn't have to rely on the platform specific behavior of closing a listening socket
+        fd_set sockets;
+        FD_ZERO(&sockets);
+        FD_SET(m_listenSocket, &sockets);
+        timeval timeout = {0, 100000};
+        if (select(TOINT(m_listenSocket) + 1, &sockets, nullptr, nullptr, &timeout) <= 0)
+        {
+            continue;
+        }
+
+        const SOCKET socket = accept(m_listenSocket, nullptr, nullptr);
+        if (socket != INVALID_SOCKET)
+        {
+            const lock_guard<mutex> lock(m_cs);
+            m_connectionSockets.push_back(socket);
+            m_connectionThreads.emplace_back(&SmtpSink::ConnectionThread, this, socket);
+        }
+    }
+}
+
+void SmtpSink::ConnectionThread(SOCKET socket)
+{
+    mt19937 random(random_device{}());
+    uniform_real_distribution<double> distribution(0, 1);
+    const auto delay = [this]()
+    {
+        // Stop() interrupts it, so it doesn't have to wait for the injected latency
+        const int latency = m_latency;
+        if (latency > 0)
+        {
+            unique_lock<mutex> lock(m_cs);
+            m_cv.wait_for(lock, chrono::milliseconds(latency), [this]() { return !m_running; });
+        }
+    };
+
+    Connection connection(socket);
+    SmtpSinkMessage message = {};
+    string line;
+
+    delay();
+    connection.Write("220 localhost SmtpSink ready\r\n");
+    while (m_running && connection.ReadLine(line))
+    {
+        string verb = line.substr(0, line.find(' '));
+        ranges::transform(verb, verb.begin(), [](char c) { return TOCHAR(toupper(TOUCHAR(c))); });
+
+        if (verb == "EHLO")
+        {
+            connection.Write(string("250-localhost\r\n") + (m_tls && !connection.IsSecure() ? "250-STARTTLS\r\n" : "") +
+                             "250-AUTH PLAIN LOGIN\r\n250-8BITMIME\r\n250 SIZE 104857600\r\n");
+        }
+        else if (verb == "HELO")
+        {
+            connection.Write("250 localhost\r\n");
+        }
+        else if (verb == "STARTTLS")
+        {
+            if (!m_tls || connection.IsSecure())
+            {
+                connection.Write("502 5.5.1 STARTTLS not available\r\n");
+                continue;
+            }
+            connection.Write("220 2.0.0 ready to start TLS\r\n");
+            if (!connection.StartTls(*m_tls))
+            {
+                break;
+            }
+            message = {};
+        }
+        else if (verb == "AUTH")
+        {
+            // any credentials will do; without an initial response, PLAIN takes one more line and LOGIN two
+            const auto words = Split(line, ' ');
+            if (words.size() == 2 && words[1] == "LOGIN")
+            {
+                connection.Write("334 VXNlcm5hbWU6\r\n");
+                connection.ReadLine(line);
+                connection.Write("334 UGFzc3dvcmQ6\r\n");
+                connection.ReadLine(line);
+            }
+            else if (words.size() == 2)
+            {
+                connection.Write("334 \r\n");
+                connection.ReadLine(line);
+            }
+            connection.Write("235 2.7.0 authentication successful\r\n");
+        }
+        else if (verb == "MAIL")
+        {
+            if (distribution(random) < m_failureRate)
+            {
+                connection.Write("451 4.3.0 temporary failure, try again later\r\n");
+                continue;
+            }
+            message = {};
+            message.from = GetAddress(line);
+            connection.Write("250 2.1.0 ok\r\n");
+        }
+        else if (verb == "RCPT")
+        {
+            message.recipients.push_back(GetAddress(line));
+            connection.Write("250 2.1.5 ok\r\n");
+        }
+        else if (verb == "DATA")
+        {
+            if (message.recipients.empty())
+            {
+                connection.Write("503 5.5.1 no valid recipients\r\n");
+                continue;
+            }
+            connection.Write("354 end data with <CR><LF>.<CR><LF>\r\n");
+
+            bool complete = false;
+            while (connection.ReadLine(line))
+            {
+                if (line == ".")
+                {
+                    complete = true;
+                    break;
+                }
+                // remove the dot-stuffing
+                message.data.append(line, line.starts_with('.') ? 1 : 0).append("\r\n");
+            }
+            if (!complete)
+            {
+                break;
+            }
+
+            message.secure = connection.IsSecure();
+            message.receivedTime = SteadyTime();
+            delay();
+            AddMessage(std::move(message));
+            message = {};
+            connection.Write("250 2.0.0 ok, queued\r\n");
+        }
+        else if (verb == "RSET")
+        {
+            message = {};
+            connection.Write("250 2.0.0 ok\r\n");
+        }
+        else if (verb == "NOOP")
+        {
+            connection.Write("250 2.0.0 ok\r\n");
+        }
+        else if (verb == "QUIT")
+        {
+            connection.Write("221 2.0.0 bye\r\n");
+            break;
+        }
+        else
+        {
+            connection.Write("500 5.5.2 command not recognized\r\n");
+        }
+    }
+
+    const lock_guard<mutex> lock(m_cs);
+    erase(m_connectionSockets, socket);
+    closesocket(socket);
+}
@@ -0,0 +1,122 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Matjaž Terpin (mt.dev@gmx.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Official repository: https://github.com/matjazt/SvcWatchDog
+ */
+
+#include <Logger/Logger.h>
+#include <Test/SmtpSink.h>
+#include <Test/SmtpSinkTest.h>
+#include <curl/curl.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+size_t ReadData(char* buffer, size_t size, size_t count, void* userData)
+{
+    auto& data = *static_cast<string_view*>(userData);
+    const size_t length = min(size * count, data.length());
+    memcpy(buffer, data.data(), length);
+    data.remove_prefix(length);
+    return length;
+}
+
+// Sends the email with libcurl alone, so the test doesn't depend on EmailSender; returns the curl result and the last reply code.
+CURLcode Send(uint16_t port, bool tls, string_view data, long* replyCode = nullptr)
+{
+    CURL* curl = curl_easy_init();
+    curl_slist* recipients = curl_slist_append(nullptr, "<to@localhost>");
+    const string url = "smtp://127.0.0.1:" + to_string(port);
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_USE_SSL, TOLONG(tls ? CURLUSESSL_ALL : CURLUSESSL_NONE));
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    curl_easy_setopt(curl, CURLOPT_MAIL_FROM, "<from@localhost>");
+    curl_easy_setopt(curl, CURLOPT_MAIL_RCPT, recipients);
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, ReadData);
+    curl_easy_setopt(curl, CURLOPT_READDATA, &data);
+    curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, 10000L);
+
+    const CURLcode result = curl_easy_perform(curl);
+    if (replyCode)
+    {
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, replyCode);
+    }
+    curl_slist_free_all(recipients);
+    curl_easy_cleanup(curl);
+    return result;
+}
+}  // namespace
+
+void SmtpSinkTest(bool tls)
+{
+    SmtpSink sink;
+    LOGASSERT(sink.Start(0, tls));
+    const uint16_t port = sink.GetPort();
+
+    // recording; libcurl doubles the leading dot and the sink removes it again
+    LOGASSERT(Send(port, tls, "Subject: test\r\n\r\n.leading dot\r\nbody\r\n") == CURLE_OK);
+    LOGASSERT(sink.WaitForMessages(1, 5000));
+    const auto messages = sink.TakeMessages();
+    LOGASSERT(messages.size() == 1);
+    if (!messages.empty())
+    {
+        LOGASSERT(messages[0].from == "from@localhost");
+        LOGASSERT(messages[0].recipients == vector<string>{"to@localhost"});
+        LOGASSERT(messages[0].data == "Subject: test\r\n\r\n.leading dot\r\nbody\r\n");
+        LOGASSERT(messages[0].secure == tls);
+    }
+    LOGASSERT(sink.GetMessageCount() == 0);
+
+    // temporary failures
+    sink.SetFailureRate(1);
+    long replyCode = 0;
+    LOGASSERT(Send(port, tls, "Subject: rejected\r\n\r\nbody\r\n", &replyCode) != CURLE_OK);
+    LOGASSERT(replyCode == 451);
+    LOGASSERT(sink.GetMessageCount() == 0);
+    sink.SetFailureRate(0);
+
+    // latency, injected before the greeting and before the reply to the data
+    sink.SetLatency(200);
+    const Stopwatch stopwatch;
+    LOGASSERT(Send(port, tls, "Subject: delayed\r\n\r\nbody\r\n") == CURLE_OK);
+    LOGASSERT(stopwatch.ElapsedWallMilliseconds() >= 400);
+    LOGASSERT(sink.GetMessageCount() == 1);
+
+    // Stop() doesn't wait for a connection, which is sleeping out the latency
+    sink.SetLatency(60000);
+    thread client([port, tls]() { Send(port, tls, "Subject: interrupted\r\n\r\nbody\r\n"); });
+    SLEEP(200);
+    const Stopwatch stopStopwatch;
+    sink.Stop();
+    LOGASSERT(stopStopwatch.ElapsedWallMilliseconds() < 2000);
+    client.join();
+    LOGASSERT(sink.GetMessageCount() == 1);
+}